@@ -4,35 +4,37 @@
 #include <cassert>
 #include <string>
 
-bool Actor::canMoveHere(Coord c) const { return sw().getActorsAt(c, IID_ROCK).empty(); }
-
-int Actor::attemptConsumeAtMostFood(int maxEnergy) const {
-    for (auto const& actor : sw().getActorsAt(getCoord(), IID_FOOD))
-        return static_cast<Food&>(*actor.second).consumeAtMost(maxEnergy);
-    return 0;
+namespace {
+constexpr StudentWorld::IIDMask antMask = StudentWorld::maskOf(IID_ANT_TYPE0) | StudentWorld::maskOf(IID_ANT_TYPE1) |
+                                          StudentWorld::maskOf(IID_ANT_TYPE2) | StudentWorld::maskOf(IID_ANT_TYPE3);
+constexpr StudentWorld::IIDMask grasshopperMask =
+  StudentWorld::maskOf(IID_BABY_GRASSHOPPER) | StudentWorld::maskOf(IID_ADULT_GRASSHOPPER);
+// Insects an ant of the given image ID considers to be its enemies.
+constexpr StudentWorld::IIDMask enemiesOf(int antIID) {
+    return grasshopperMask | (antMask & ~StudentWorld::maskOf(antIID));
 }
-
-void Actor::addFoodHere(int howMuch) const {
-    auto here = getCoord();
-    for (auto const& actor : sw().getActorsAt(here, IID_FOOD))
-        return static_cast<Food&>(*actor.second).increaseBy(howMuch);
-    sw().insertActor<Food>(here, howMuch);
 }
 
-void Actor::addPheromoneHere(int type) const {
-    auto here = getCoord();
-    for (auto const& actor : sw().getActorsAt(here, IID_PHEROMONE_TYPE0 + type))
-        return static_cast<Pheromone&>(*actor.second).increaseBy(256);
-    sw().insertActor<Pheromone>(here, type);
+Actor::Actor(StudentWorld& sw, int iid, Coord c, Direction dir, unsigned depth)
+  : GraphObject(iid, std::get<0>(c), std::get<1>(c), dir, depth), m_sw(sw), m_table(sw.table()),
+    m_slot(m_table.allocate()), m_iid(iid) {
+    m_table.owner[m_slot] = this;
+    m_table.iid[m_slot] = static_cast<std::uint8_t>(iid);
+    m_table.x[m_slot] = static_cast<std::int16_t>(std::get<0>(c));
+    m_table.y[m_slot] = static_cast<std::int16_t>(std::get<1>(c));
+    m_table.dir[m_slot] = static_cast<std::uint8_t>(dir);
+    m_table.id[m_slot] = sw.newActorId();
 }
 
-void PoolOfWater::doSomething() {
-    for (auto const& actor : sw().getActorsAt(getCoord())) actor.second->beStunned();
-}
+bool Actor::canMoveHere(Coord c) const { return !sw().anyActorsAt(c, StudentWorld::maskOf(IID_ROCK)); }
 
-void Poison::doSomething() {
-    for (auto const& actor : sw().getActorsAt(getCoord())) actor.second->bePoisoned();
-}
+int Actor::attemptConsumeAtMostFood(int maxEnergy) const { return sw().consumeFood(getCoord(), maxEnergy); }
+
+void Actor::addFoodHere(int howMuch) const { sw().addFood(getCoord(), howMuch); }
+
+void Actor::addPheromoneHere(int type) const { sw().addPheromone(getCoord(), type); }
+
+int Actor::randInt(int min, int max) const { return sw().randInt(m_slot, min, max); }
 
 void Anthill::doSomething() {
     if (!--currentEnergy()) return;
@@ -54,16 +56,16 @@ void Grasshopper::consumeFoodAndMove() {
             return resetSleep();
         }
     }
-    if (!m_distance) { // Step 8 (baby) or 8 (adult)
+    if (!distance()) { // Step 8 (baby) or 8 (adult)
         setDirection(randomDirection());
-        m_distance = randInt(2, 10);
+        distance() = randInt(2, 10);
     }
     auto next = nextLocation();
     if (canMoveHere(next)) { // Step 9 (baby) or 10 (adult)
         moveTo(next);
-        --m_distance; // Step 11 (baby) or 12 (adult)
+        --distance(); // Step 11 (baby) or 12 (adult)
     } else {          // Step 10 (baby) or 11 (adult)
-        m_distance = 0;
+        distance() = 0;
     }
     resetSleep(); // Step 12 (baby) or 13 (adult)
 }
@@ -80,154 +82,422 @@ void BabyGrasshopper::doSomething() {
 void AdultGrasshopper::doSomething() {
     if (!burnEnergyAndSleep()) return; // Step 1--4
     if (!randInt(0, 2)) {              // Step 5
-        auto insectsHere = findOtherInsectsHere();
-        if (!insectsHere.empty()) {
-            static_cast<Actor*>(insectsHere[randInt(0, insectsHere.size() - 1)])->beBitten(50);
+        if (Insect* victim = pickOtherInsectHere()) {
+            static_cast<Actor*>(victim)->beBitten(50);
             return resetSleep();
         }
     }
     if (!randInt(0, 9)) { // Step 6
-        auto openSquares = findOpenSquaresCenteredHere();
-        if (!openSquares.empty()) {
-            moveTo(openSquares[randInt(0, openSquares.size() - 1)]);
+        Coord target;
+        if (pickOpenSquareCenteredHere(target)) {
+            moveTo(target);
             return resetSleep();
         }
     }
     consumeFoodAndMove(); // Steps 7--13
 }
 
-std::vector<Coord> AdultGrasshopper::findOpenSquaresCenteredHere() const {
+bool AdultGrasshopper::pickOpenSquareCenteredHere(Coord& c) const {
     int const radius = 10;
-    std::vector<Coord> rv;
     int x0 = getX(), y0 = getY();
     int minX = std::max(1, x0 - radius), minY = std::max(1, y0 - radius);
     int maxX = std::min(VIEW_WIDTH - 2, x0 + radius), maxY = std::min(VIEW_HEIGHT - 2, y0 + radius);
+    auto isOpen = [&](int x, int y) {
+        return (x != x0 || y != y0) && (x - x0) * (x - x0) + (y - y0) * (y - y0) <= radius * radius &&
+               canMoveHere({x, y});
+    };
+    // Count the open squares first and then walk to the chosen one, rather
+    // than collecting them into a vector on every jump.
+    int n = 0;
+    for (int x = minX; x <= maxX; ++x)
+        for (int y = minY; y <= maxY; ++y) n += isOpen(x, y);
+    if (!n) return false;
+    int k = randInt(0, n - 1);
     for (int x = minX; x <= maxX; ++x)
         for (int y = minY; y <= maxY; ++y)
-            if ((x != x0 || y != y0) && (x - x0) * (x - x0) + (y - y0) * (y - y0) <= radius * radius &&
-                canMoveHere({x, y}))
-                rv.emplace_back(x, y);
-    return rv;
+            if (isOpen(x, y) && !k--) {
+                c = std::make_tuple(x, y);
+                return true;
+            }
+    assert(false && "open square disappeared");
+    return false;
 }
 
-std::vector<Insect*> Insect::findOtherInsectsHere() const {
-    auto actorsHere = sw().getActorsAt(getCoord());
-    std::vector<Insect*> insectsHere; // TODO use better search
-    for (auto const& actor : actorsHere) {
-        int iid = actor.second->iid();
-        if ((iid == IID_ADULT_GRASSHOPPER || iid == IID_BABY_GRASSHOPPER ||
-             (iid >= IID_ANT_TYPE0 && iid <= IID_ANT_TYPE3)) &&
-            actor.second.get() != this && !actor.second->isDead())
-            insectsHere.emplace_back(static_cast<Insect*>(actor.second.get()));
-    }
-    return insectsHere;
+Insect* Insect::pickOtherInsectHere(int excludedIID) const {
+    auto isCandidate = [this, excludedIID](Actor* actor) {
+        int iid = actor->iid();
+        return (iid == IID_ADULT_GRASSHOPPER || iid == IID_BABY_GRASSHOPPER ||
+                (iid >= IID_ANT_TYPE0 && iid <= IID_ANT_TYPE3)) &&
+               iid != excludedIID && actor != this && !actor->isDead();
+    };
+    int n = 0;
+    for (Actor* actor : sw().getActorsAt(getCoord())) n += isCandidate(actor);
+    if (!n) return nullptr;
+    int k = randInt(0, n - 1);
+    for (Actor* actor : sw().getActorsAt(getCoord()))
+        if (isCandidate(actor) && !k--) return static_cast<Insect*>(actor);
+    assert(false && "insect disappeared");
+    return nullptr;
 }
 
 void Ant::doSomething() {
     if (!burnEnergyAndSleep()) return; // Step 1--3
-    for (int i = 0; i < 10; ++i)
-        if (!evalInstr()) return; // Step 4
+    sw().countAntInstructions(runBurst(sw().antDispatch())); // Step 4
 }
 
+int Ant::runBurst(AntDispatch d) {
+    m_sensed = m_holds = 0; // See senseIf.
+    auto runMachineCode = [this](auto run) {
+        std::uint32_t pc = ic();
+        int executed = run(&pc);
+        ic() = pc;
+        return executed;
+    };
+    // Native code built by bug2cpp stands in for the program it came from.
+    if (NativeProgram const* native = sw().antNative(getType()))
+        return runMachineCode([&](std::uint32_t* pc) { return native->burst(this, pc, machineCodeCallbacks); });
+    if (d == AntDispatch::jit) {
+        if (JitProgram const* jit = sw().antJit(getType()))
+            return runMachineCode([&](std::uint32_t* pc) { return jit->run(this, pc); });
+        d = AntDispatch::threaded;
+    }
+    if (d == AntDispatch::batched) {
+        std::uint32_t pc;
+        int executed;
+        if (sw().takeBatchedBurst(slot(), pc, executed)) {
+            ic() = pc;
+            return runBurstSwitched(executed);
+        }
+        d = AntDispatch::switched;
+    }
+    if (d == AntDispatch::tabled) return runBurstTabled();
+#if BUGS_THREADED_DISPATCH
+    if (d == AntDispatch::threaded) return runBurstThreaded();
+#endif
+    return runBurstSwitched(0);
+}
+
+JitProgram::Callbacks const Ant::machineCodeCallbacks = {
+    [](void* ant, int cond) { return static_cast<Ant*>(ant)->senseIf(static_cast<Compiler::Condition>(cond)); },
+    [](void* ant, int op) { static_cast<Ant*>(ant)->performAction(static_cast<Compiler::Opcode>(op)); },
+    [](void* ant, int bound) { static_cast<Ant*>(ant)->generateRandomNumber(bound); },
+    [](void* ant) { static_cast<Ant*>(ant)->decrementEnergy(static_cast<Ant*>(ant)->currentEnergy()); },
+};
+
 bool Ant::evalIf(Compiler::Condition cond) const {
     switch (cond) {
-    case Compiler::Condition::last_random_number_was_zero: return m_rand == 0;
-    case Compiler::Condition::i_am_carrying_food: return m_foodHeld > 0;
+    case Compiler::Condition::last_random_number_was_zero: return lastRandom() == 0;
+    case Compiler::Condition::i_am_carrying_food: return foodHeld() > 0;
     case Compiler::Condition::i_am_hungry: return currentEnergy() <= 25;
     case Compiler::Condition::i_am_standing_with_an_enemy:
-        for (auto const& actor : sw().getActorsAt(getCoord())) {
-            int iid = actor.second->iid();
-            if (iid == IID_ADULT_GRASSHOPPER || iid == IID_BABY_GRASSHOPPER ||
-                (iid >= IID_ANT_TYPE0 && iid <= IID_ANT_TYPE3 && this->iid() != iid))
-                return true;
-        }
-        return false;
+        return sw().anyActorsAt(getCoord(), enemiesOf(iid()));
     case Compiler::Condition::i_am_standing_on_my_anthill:
-        for (auto const& actor : sw().getActorsAt(getCoord(), IID_ANT_HILL))
-            if (static_cast<Anthill&>(*actor.second).getType() == this->getType()) return true;
-        return false;
-    case Compiler::Condition::i_am_standing_on_food: return !sw().getActorsAt(getCoord(), IID_FOOD).empty();
-    case Compiler::Condition::i_smell_pheromone_in_front_of_me:
-        for (auto const& actor : sw().getActorsAt(nextLocation())) {
-            int iid = actor.second->iid();
-            if (iid >= IID_PHEROMONE_TYPE0 && iid <= IID_PHEROMONE_TYPE3) return true;
-        }
+        for (Actor* actor : sw().getActorsAt(getCoord(), IID_ANT_HILL))
+            if (static_cast<Anthill*>(actor)->getType() == this->getType()) return true;
         return false;
+    case Compiler::Condition::i_am_standing_on_food:
+        return sw().anyActorsAt(getCoord(), StudentWorld::maskOf(IID_FOOD));
+    case Compiler::Condition::i_smell_pheromone_in_front_of_me: return sw().anyPheromoneAt(nextLocation());
     case Compiler::Condition::i_smell_danger_in_front_of_me:
-        for (auto const& actor : sw().getActorsAt(nextLocation())) {
-            int iid = actor.second->iid();
-            if (iid == IID_POISON || iid == IID_ADULT_GRASSHOPPER || iid == IID_BABY_GRASSHOPPER ||
-                (iid >= IID_ANT_TYPE0 && iid <= IID_ANT_TYPE3 && this->iid() != iid))
-                return true;
-        }
-        return false;
-    case Compiler::Condition::i_was_bit: return m_isBitten;
-    case Compiler::Condition::i_was_blocked_from_moving: return m_isBlocked;
+        return sw().anyActorsAt(nextLocation(), StudentWorld::maskOf(IID_POISON) | enemiesOf(iid()));
+    case Compiler::Condition::i_was_bit: return hasFlag(ActorTable::bitten);
+    case Compiler::Condition::i_was_blocked_from_moving: return hasFlag(ActorTable::blocked);
     case Compiler::Condition::invalid_if: assert(false && "invalid if condition in compiled Ant instructions");
     }
     assert(false && "unknown if condition in compiled Ant instructions");
 }
 
-bool Ant::evalInstr() {
-    Compiler::Command cmd;
-    if (!m_comp.getCommand(m_ic++, cmd)) {
-        decrementEnergy(currentEnergy());
-        return false;
-    }
-    switch (cmd.opcode) {
-    case Compiler::Opcode::moveForward: {
-        auto next = nextLocation();
-        if (canMoveHere(next)) {
-            moveTo(next);
-            m_isBlocked = false;
-        } else {
-            m_isBlocked = true;
+// The runBurst functions execute up to 10 instructions, stopping after the
+// first one that changes the world or when the program runs out, and return
+// the number of instructions executed. The interpreters run the optimized program, in
+// which a jump may stand for a chain of several instructions; such a jump is
+// only taken if the whole chain fits in what is left of the 10, and otherwise
+// the instruction as written is executed in its place.
+
+int Ant::runBurstSwitched(int executed) {
+    auto const& program = m_comp.getOptimizedInstructions();
+    auto const& plain = m_comp.getInstructions();
+    std::uint32_t pc = ic();
+    auto jump = [&](Compiler::Instruction const& instr) {
+        if (executed + instr.cost - 1 <= 10) {
+            pc = instr.operand;
+            executed += instr.cost - 1;
+        } else if (instr.opcode != Compiler::Opcode::clearRandomNumber) {
+            pc = plain[pc - 1].operand;
         }
-        return false;
+    };
+    while (executed < 10) {
+        if (pc >= program.size()) {
+            decrementEnergy(currentEnergy());
+            break;
+        }
+        Compiler::Instruction const& instr = program[pc++];
+        ++executed;
+        switch (static_cast<Compiler::Opcode>(instr.opcode)) {
+        case Compiler::Opcode::moveForward:
+        case Compiler::Opcode::eatFood:
+        case Compiler::Opcode::dropFood:
+        case Compiler::Opcode::bite:
+        case Compiler::Opcode::pickupFood:
+        case Compiler::Opcode::emitPheromone:
+        case Compiler::Opcode::faceRandomDirection:
+        case Compiler::Opcode::rotateClockwise:
+        case Compiler::Opcode::rotateCounterClockwise: performAction(static_cast<Compiler::Opcode>(instr.opcode)); break;
+        case Compiler::Opcode::generateRandomNumber: generateRandomNumber(instr.operand); continue;
+        case Compiler::Opcode::clearRandomNumber:
+            lastRandom() = 0;
+            jump(instr);
+            continue;
+        case Compiler::Opcode::goto_command: jump(instr); continue;
+        case Compiler::Opcode::if_command:
+            if (senseIf(static_cast<Compiler::Condition>(instr.condition))) jump(instr);
+            continue;
+        case Compiler::Opcode::label: assert(false && "unresolved label in compiled Ant instructions"); break;
+        case Compiler::Opcode::invalid: assert(false && "invalid instruction in compiled Ant instructions"); break;
+        }
+        break;
     }
-    case Compiler::Opcode::eatFood: {
-        int toEat = std::min(100, m_foodHeld);
-        m_foodHeld -= toEat;
-        currentEnergy() += toEat;
-        return false;
+    ic() = pc;
+    return executed;
+}
+
+#if BUGS_THREADED_DISPATCH
+int Ant::runBurstThreaded() {
+    // Indexed by opcode + 1 and by condition + 1.
+    static void* const opcodes[] = {&&op_invalid, &&op_label, &&op_goto, &&op_if, &&op_emitPheromone,
+                                    &&op_faceRandomDirection, &&op_rotateCW, &&op_rotateCCW, &&op_moveForward,
+                                    &&op_bite, &&op_pickupFood, &&op_dropFood, &&op_eatFood, &&op_generateRandomNumber,
+                                    &&op_clearRandomNumber};
+    static_assert(sizeof(opcodes) / sizeof(*opcodes) == Compiler::Opcode::clearRandomNumber + 2,
+                  "opcode table out of sync with Compiler::Opcode");
+    static void* const conditions[] = {&&if_invalid, &&if_smellDanger, &&if_smellPheromone, &&if_wasBit,
+                                       &&if_carryingFood, &&if_hungry, &&if_onMyAnthill, &&if_onFood, &&if_withEnemy,
+                                       &&if_blockedFromMoving, &&if_lastRandomWasZero};
+    static_assert(sizeof(conditions) / sizeof(*conditions) == Compiler::Condition::last_random_number_was_zero + 2,
+                  "condition table out of sync with Compiler::Condition");
+
+    auto const& program = m_comp.getOptimizedInstructions();
+    Compiler::Instruction const* const code = program.data();
+    Compiler::Instruction const* const plain = m_comp.getInstructions().data();
+    std::uint32_t const size = static_cast<std::uint32_t>(program.size());
+    std::uint32_t pc = ic();
+    Compiler::Instruction const* instr = nullptr;
+    int executed = 0;
+    bool taken = false;
+
+#define DISPATCH()                                                                                                     \
+    do {                                                                                                               \
+        if (executed == 10) goto done;                                                                                 \
+        if (pc >= size) goto fell_off;                                                                                 \
+        instr = &code[pc++];                                                                                           \
+        ++executed;                                                                                                    \
+        goto* opcodes[instr->opcode + 1];                                                                              \
+    } while (false)
+
+    DISPATCH();
+
+op_goto:
+jump:
+    if (executed + instr->cost - 1 <= 10) {
+        pc = instr->operand;
+        executed += instr->cost - 1;
+    } else if (instr->opcode != Compiler::Opcode::clearRandomNumber) {
+        pc = plain[pc - 1].operand;
     }
-    case Compiler::Opcode::dropFood:
-        if (m_foodHeld) {
-            addFoodHere(m_foodHeld);
-            m_foodHeld = 0;
+    DISPATCH();
+op_clearRandomNumber:
+    lastRandom() = 0;
+    goto jump;
+op_if:
+    goto* conditions[instr->condition + 1];
+op_generateRandomNumber:
+    generateRandomNumber(instr->operand);
+    DISPATCH();
+op_moveForward:
+    moveForward();
+    goto done;
+op_eatFood:
+    eatFood();
+    goto done;
+op_dropFood:
+    dropFood();
+    goto done;
+op_bite:
+    bite();
+    goto done;
+op_pickupFood:
+    pickupFood();
+    goto done;
+op_emitPheromone:
+    addPheromoneHere(getType());
+    goto done;
+op_faceRandomDirection:
+    setDirection(randomDirection());
+    goto done;
+op_rotateCW:
+    rotate(1);
+    goto done;
+op_rotateCCW:
+    rotate(3);
+    goto done;
+op_label:
+    assert(false && "unresolved label in compiled Ant instructions");
+    goto done;
+op_invalid:
+    assert(false && "invalid instruction in compiled Ant instructions");
+    goto done;
+
+if_lastRandomWasZero:
+    taken = lastRandom() == 0;
+    goto branch;
+if_carryingFood:
+    taken = foodHeld() > 0;
+    goto branch;
+if_hungry:
+    taken = currentEnergy() <= 25;
+    goto branch;
+if_wasBit:
+    taken = hasFlag(ActorTable::bitten);
+    goto branch;
+if_blockedFromMoving:
+    taken = hasFlag(ActorTable::blocked);
+    goto branch;
+if_smellDanger:
+    taken = senseIf(Compiler::Condition::i_smell_danger_in_front_of_me);
+    goto branch;
+if_smellPheromone:
+    taken = senseIf(Compiler::Condition::i_smell_pheromone_in_front_of_me);
+    goto branch;
+if_onMyAnthill:
+    taken = senseIf(Compiler::Condition::i_am_standing_on_my_anthill);
+    goto branch;
+if_onFood:
+    taken = senseIf(Compiler::Condition::i_am_standing_on_food);
+    goto branch;
+if_withEnemy:
+    taken = senseIf(Compiler::Condition::i_am_standing_with_an_enemy);
+    goto branch;
+if_invalid:
+    assert(false && "invalid if condition in compiled Ant instructions");
+    goto done;
+branch:
+    if (taken) goto jump;
+    DISPATCH();
+
+#undef DISPATCH
+
+fell_off:
+    decrementEnergy(currentEnergy());
+done:
+    ic() = pc;
+    return executed;
+}
+#endif
+
+int Ant::runBurstTabled() {
+    auto const& plain = m_comp.getInstructions();
+    std::uint32_t pc = ic();
+    int executed = 0;
+    bool acted = false;
+    while (!acted && executed < 10) {
+        if (pc >= plain.size()) {
+            decrementEnergy(currentEnergy());
+            break;
+        }
+        Compiler::Segment const& segment = m_comp.getSegment(pc, 10 - executed);
+        if (segment.conditions == Compiler::NOT_TABULATED) {
+            ic() = pc;
+            return runBurstSwitched(executed);
+        }
+        unsigned index = 0, n = 0;
+        for (unsigned c = 0; c <= Compiler::Condition::last_random_number_was_zero; ++c)
+            if (segment.conditions >> c & 1) index |= unsigned{senseIf(static_cast<Compiler::Condition>(c))} << n++;
+        Compiler::Outcome const& outcome = m_comp.getOutcome(segment, index);
+        executed += outcome.consumed;
+        pc = outcome.at;
+        switch (outcome.end) {
+        case Compiler::SegmentEnd::act:
+            performAction(static_cast<Compiler::Opcode>(plain[pc++].opcode));
+            acted = true;
+            break;
+        case Compiler::SegmentEnd::generate: generateRandomNumber(plain[pc++].operand); break;
+        case Compiler::SegmentEnd::exhausted: break;
+        case Compiler::SegmentEnd::fellOff: break; // Dies at the top of the loop.
         }
-        return false;
-    case Compiler::Opcode::bite: {
-        auto insectsHere = findOtherInsectsHere();
-        insectsHere.erase(
-          std::remove_if(insectsHere.begin(), insectsHere.end(), [this](Insect* i) { return i->iid() == iid(); }),
-          insectsHere.end());
-        if (!insectsHere.empty()) static_cast<Actor*>(insectsHere[randInt(0, insectsHere.size() - 1)])->beBitten(15);
-        return false;
     }
-    case Compiler::Opcode::pickupFood:
-        m_foodHeld += attemptConsumeAtMostFood(std::min(400, 1800 - m_foodHeld));
-        return false;
-    case Compiler::Opcode::emitPheromone: addPheromoneHere(getType()); return false;
-    case Compiler::Opcode::faceRandomDirection: setDirection(randomDirection()); return false;
-    case Compiler::Opcode::generateRandomNumber: {
-        int operand1 = std::stoi(cmd.operand1);
-        assert(operand1 >= 0);
-        m_rand = operand1 ? randInt(0, operand1 - 1) : 0;
-        return true;
-    }
-    case Compiler::Opcode::goto_command: m_ic = std::stoi(cmd.operand1); return true;
-    case Compiler::Opcode::if_command:
-        if (evalIf(static_cast<Compiler::Condition>(std::stoi(cmd.operand1)))) m_ic = std::stoi(cmd.operand2);
-        return true;
-    case Compiler::Opcode::rotateClockwise:
-        setDirection(static_cast<Direction>((getDirection() - up + 1) % 4 + up));
-        return false;
-    case Compiler::Opcode::rotateCounterClockwise:
-        setDirection(static_cast<Direction>((getDirection() - up + 3) % 4 + up));
-        return false;
-    case Compiler::Opcode::label: assert(false && "unresolved label in compiled Ant instructions");
-    case Compiler::Opcode::invalid: assert(false && "invalid instruction in compiled Ant instructions");
+    ic() = pc;
+    return executed;
+}
+
+// Conditions about the world around the ant are sensed at most once per
+// burst: nothing else moves while the ant runs, and the first action that
+// could change what it senses ends the burst. Conditions about the ant itself
+// are as cheap to evaluate as to remember, and generateRandomNumber changes
+// last_random_number_was_zero within the burst, so they are always evaluated.
+bool Ant::senseIf(Compiler::Condition cond) {
+    unsigned const bit = 1u << cond;
+    unsigned const world = 1u << Compiler::Condition::i_smell_danger_in_front_of_me |
+                           1u << Compiler::Condition::i_smell_pheromone_in_front_of_me |
+                           1u << Compiler::Condition::i_am_standing_on_my_anthill |
+                           1u << Compiler::Condition::i_am_standing_on_food |
+                           1u << Compiler::Condition::i_am_standing_with_an_enemy;
+    if (!(world & bit)) return evalIf(cond);
+    bool remembered = m_sensed & bit;
+    sw().countSensedCondition(cond, remembered);
+    if (!remembered) {
+        m_sensed |= bit;
+        if (evalIf(cond)) m_holds |= bit;
     }
-    assert(false && "unknown instruction in compiled Ant instructions");
+    return m_holds & bit;
+}
+
+void Ant::performAction(Compiler::Opcode op) {
+    switch (op) {
+    case Compiler::Opcode::moveForward: moveForward(); break;
+    case Compiler::Opcode::eatFood: eatFood(); break;
+    case Compiler::Opcode::dropFood: dropFood(); break;
+    case Compiler::Opcode::bite: bite(); break;
+    case Compiler::Opcode::pickupFood: pickupFood(); break;
+    case Compiler::Opcode::emitPheromone: addPheromoneHere(getType()); break;
+    case Compiler::Opcode::faceRandomDirection: setDirection(randomDirection()); break;
+    case Compiler::Opcode::rotateClockwise: rotate(1); break;
+    case Compiler::Opcode::rotateCounterClockwise: rotate(3); break;
+    default: assert(false && "not an action in compiled Ant instructions");
+    }
+}
+
+void Ant::moveForward() {
+    auto next = nextLocation();
+    if (canMoveHere(next)) {
+        moveTo(next);
+        setFlag(ActorTable::blocked, false);
+    } else {
+        setFlag(ActorTable::blocked, true);
+    }
+}
+
+void Ant::eatFood() {
+    int toEat = std::min(100, foodHeld());
+    foodHeld() -= toEat;
+    currentEnergy() += toEat;
+}
+
+void Ant::dropFood() {
+    if (foodHeld()) {
+        addFoodHere(foodHeld());
+        foodHeld() = 0;
+    }
+}
+
+void Ant::bite() {
+    if (Insect* victim = pickOtherInsectHere(iid())) static_cast<Actor*>(victim)->beBitten(15);
+}
+
+void Ant::pickupFood() { foodHeld() += attemptConsumeAtMostFood(std::min(400, 1800 - foodHeld())); }
+
+void Ant::generateRandomNumber(int bound) {
+    // With only one possible outcome, do not draw from the random number
+    // generator, so that the optimizer may fold generateRandomNumber 1.
+    assert(bound >= 0);
+    lastRandom() = bound > 1 ? randInt(0, bound - 1) : 0;
 }
@@ -1,9 +1,12 @@
 #ifndef ACTOR_H_
 #define ACTOR_H_
 
+#include "ActorTable.h"
 #include "Compiler.h"
 #include "GraphObject.h"
+#include "JitProgram.h"
 #include <cassert>
+#include <cstdint>
 #include <tuple>
 #include <utility>
 
@@ -11,14 +14,41 @@ typedef std::tuple<int, int> Coord;
 
 class StudentWorld;
 
+// How ants dispatch on their instructions. Threaded dispatch jumps straight
+// from one instruction to the next through a table of label addresses, which
+// relies on the labels-as-values extension of GCC and Clang. The JIT runs the
+// program as machine code (see JitProgram) and falls back to the default
+// interpreter where that is not available. Batch dispatch starts the bursts
+// of all ants of a colony together; see StudentWorld::prepareBatchedBursts.
+#if defined(__GNUC__) && !defined(BUGS_NO_THREADED_DISPATCH)
+#define BUGS_THREADED_DISPATCH 1
+#else
+#define BUGS_THREADED_DISPATCH 0
+#endif
+enum class AntDispatch : std::uint8_t { switched, threaded, tabled, jit, batched };
+
+// The position, direction and all other mutable state of an actor live in its
+// row of the ActorTable owned by StudentWorld. The GraphObject base is kept in
+// sync only so that the actor is drawn where it is.
 class Actor : public GraphObject {
 private:
+    friend class StudentWorld;
     StudentWorld& m_sw;
+    ActorTable& m_table;
+    ActorTable::Slot m_slot;
     int m_iid;
 
 protected:
-    Actor(StudentWorld& sw, int iid, Coord c, Direction dir, unsigned depth)
-      : GraphObject(iid, std::get<0>(c), std::get<1>(c), dir, depth), m_sw(sw), m_iid(iid) {}
+    Actor(StudentWorld& sw, int iid, Coord c, Direction dir, unsigned depth);
+    ActorTable& table() const { return m_table; }
+    ActorTable::Slot slot() const { return m_slot; }
+    bool hasFlag(ActorTable::Flag f) const { return m_table.flags[m_slot] & f; }
+    void setFlag(ActorTable::Flag f, bool on) {
+        if (on)
+            m_table.flags[m_slot] |= f;
+        else
+            m_table.flags[m_slot] &= ~f;
+    }
     bool canMoveHere(Coord c) const;
     Coord nextLocation() const {
         switch (getDirection()) {
@@ -29,16 +59,31 @@ protected:
         case Direction::right: return std::make_tuple(getX() + 1, getY());
         }
     }
-    void moveTo(Coord c) { GraphObject::moveTo(std::get<0>(c), std::get<1>(c)); }
+    void moveTo(Coord c) {
+        m_table.x[m_slot] = static_cast<std::int16_t>(std::get<0>(c));
+        m_table.y[m_slot] = static_cast<std::int16_t>(std::get<1>(c));
+        GraphObject::moveTo(std::get<0>(c), std::get<1>(c));
+    }
+    void setDirection(Direction d) {
+        m_table.dir[m_slot] = static_cast<std::uint8_t>(d);
+        GraphObject::setDirection(d);
+    }
     int attemptConsumeAtMostFood(int maxEnergy) const;
     void addFoodHere(int howMuch) const;
     void addPheromoneHere(int type) const;
-    static auto randomDirection() { return static_cast<Direction>(randInt(up, left)); }
+    // Draws from the random number generator of the world, inclusive of both
+    // bounds.
+    int randInt(int min, int max) const;
+    Direction randomDirection() const { return static_cast<Direction>(randInt(up, left)); }
     Coord getCoord() const { return std::make_tuple(getX(), getY()); }
     StudentWorld& sw() const { return m_sw; }
 
 public:
+    virtual ~Actor() { m_table.release(m_slot); }
     virtual void doSomething() = 0;
+    int getX() const { return m_table.x[m_slot]; }
+    int getY() const { return m_table.y[m_slot]; }
+    Direction getDirection() const { return static_cast<Direction>(m_table.dir[m_slot]); }
     int iid() const { return m_iid; }
     std::tuple<int, int, int> getKey() const { return std::make_tuple(getX(), getY(), iid()); }
     virtual bool isDead() const { return false; }
@@ -47,74 +92,26 @@ public:
     virtual void beBitten(int) {}
 };
 
-class Pebble final : public Actor {
+// Pebbles, pools of water, poison, food and pheromones are not Actors at all.
+// StudentWorld keeps them in per-cell planes and implements their behavior
+// itself; it only keeps these objects around so that they are drawn.
+class Sprite final : public GraphObject {
 public:
-    Pebble(StudentWorld& sw, Coord c) : Actor(sw, IID_ROCK, c, right, 1) {}
-
-private:
-    virtual void doSomething() override {}
-};
-
-class PoolOfWater final : public Actor {
-public:
-    PoolOfWater(StudentWorld& sw, Coord c) : Actor(sw, IID_WATER_POOL, c, right, 2) {}
-
-private:
-    virtual void doSomething() override;
-};
-
-class Poison final : public Actor {
-public:
-    Poison(StudentWorld& sw, Coord c) : Actor(sw, IID_POISON, c, right, 2) {}
-
-private:
-    virtual void doSomething() override;
+    Sprite(int iid, Coord c) : GraphObject(iid, std::get<0>(c), std::get<1>(c), right, iid == IID_ROCK ? 1 : 2) {}
 };
 
 class EnergyHolder : public Actor {
-private:
-    int m_currentEnergy;
-
 protected:
-    int const& currentEnergy() const { return m_currentEnergy; }
-    int& currentEnergy() { return m_currentEnergy; }
+    std::int32_t const& currentEnergy() const { return table().energy[slot()]; }
+    std::int32_t& currentEnergy() { return table().energy[slot()]; }
     template<typename... Args>
-    EnergyHolder(int initialEnergy, Args&&... args)
-      : Actor(std::forward<Args>(args)...), m_currentEnergy{initialEnergy} {}
-    virtual bool isDead() const override {
-        assert(m_currentEnergy >= 0);
-        return !m_currentEnergy;
-    }
-};
-
-class Food final : public EnergyHolder {
-private:
-    virtual void doSomething() override {}
-
-public:
-    Food(StudentWorld& sw, Coord c, int energy) : EnergyHolder(energy, sw, IID_FOOD, c, right, 2) {}
-    void increaseBy(int howMuch) { currentEnergy() += howMuch; }
-    int consumeAtMost(int howMuch) {
-        int actualConsumed = std::min(howMuch, currentEnergy());
-        currentEnergy() -= actualConsumed;
-        return actualConsumed;
+    EnergyHolder(int initialEnergy, Args&&... args) : Actor(std::forward<Args>(args)...) {
+        currentEnergy() = initialEnergy;
     }
-};
-
-class Pheromone final : public EnergyHolder {
-public:
-    Pheromone(StudentWorld& sw, Coord c, int type) : EnergyHolder(256, sw, typeToIID(type), c, right, 2) {}
-    void increaseBy(int howMuch) { currentEnergy() = std::max(768, currentEnergy() + howMuch); }
-
-private:
-    static int typeToIID(int type) {
-        assert(0 <= type && type < 4);
-        static_assert(IID_PHEROMONE_TYPE0 + 1 == IID_PHEROMONE_TYPE1, "Unexpected IID_PHEROMONE_TYPE1 index");
-        static_assert(IID_PHEROMONE_TYPE0 + 2 == IID_PHEROMONE_TYPE2, "Unexpected IID_PHEROMONE_TYPE2 index");
-        static_assert(IID_PHEROMONE_TYPE0 + 3 == IID_PHEROMONE_TYPE3, "Unexpected IID_PHEROMONE_TYPE3 index");
-        return IID_PHEROMONE_TYPE0 + type;
+    virtual bool isDead() const override {
+        assert(currentEnergy() >= 0);
+        return !currentEnergy();
     }
-    virtual void doSomething() override { --currentEnergy(); }
 };
 
 class Anthill final : public EnergyHolder {
@@ -133,12 +130,13 @@ private:
 
 class Insect : public EnergyHolder {
 private:
-    int m_sleep;
-    bool m_hasBeenStunnedHere;
+    std::int32_t& sleep() { return table().sleep[slot()]; }
 
 protected:
     Insect(int initialEnergy, StudentWorld& sw, int iid, Coord c)
-      : EnergyHolder(initialEnergy, sw, iid, c, randomDirection(), 1), m_sleep(0), m_hasBeenStunnedHere(false) {}
+      : EnergyHolder(initialEnergy, sw, iid, c, right, 1) {
+        setDirection(randomDirection());
+    }
     bool decrementEnergy(int howMuch) {
         currentEnergy() -= howMuch;
         assert(currentEnergy() >= 0);
@@ -149,23 +147,25 @@ protected:
         if (!decrementEnergy(1)) { // Step 1, 2
             return false;
         }
-        if (m_sleep) { // Step 3, 4
-            --m_sleep;
+        if (sleep()) { // Step 3, 4
+            --sleep();
             return false;
         }
         return true;
     }
-    void resetSleep() { m_sleep = 2; }
+    void resetSleep() { sleep() = 2; }
     void moveTo(Coord c) { // Overload not override. No virtual needed.
         assert(c != getCoord());
         Actor::moveTo(c);
-        m_hasBeenStunnedHere = false;
+        setFlag(ActorTable::stunnedHere, false);
     }
-    std::vector<Insect*> findOtherInsectsHere() const;
+    // Picks a random live insect here other than this one and those with the
+    // excluded image ID, or returns nullptr if there is none.
+    Insect* pickOtherInsectHere(int excludedIID = -1) const;
     virtual void beStunned() override {
-        if (!m_hasBeenStunnedHere) {
-            m_hasBeenStunnedHere = true;
-            m_sleep += 2;
+        if (!hasFlag(ActorTable::stunnedHere)) {
+            setFlag(ActorTable::stunnedHere, true);
+            sleep() += 2;
         }
     }
     virtual void bePoisoned() override { decrementEnergy(std::min(150, currentEnergy())); }
@@ -175,15 +175,19 @@ protected:
 class Ant final : public Insect {
 public:
     Ant(StudentWorld& sw, Coord c, int type, Compiler const& comp)
-      : Insect(1500, sw, typeToIID(type), c), m_comp(comp), m_ic(0), m_rand(0), m_foodHeld(0), m_isBlocked(false),
-        m_isBitten(false) {}
+      : Insect(1500, sw, typeToIID(type), c), m_comp(comp), m_sensed(0), m_holds(0) {}
 
 private:
     virtual void doSomething() override;
     Compiler const& m_comp;
-    size_t m_ic;
-    int m_rand, m_foodHeld;
-    bool m_isBlocked, m_isBitten;
+    // The conditions about the world around the ant sensed so far in the
+    // current burst, and which of them hold; see senseIf.
+    std::uint16_t m_sensed, m_holds;
+    std::uint32_t& ic() { return table().ic[slot()]; }
+    std::int32_t lastRandom() const { return table().rand[slot()]; }
+    std::int32_t& lastRandom() { return table().rand[slot()]; }
+    std::int32_t foodHeld() const { return table().foodHeld[slot()]; }
+    std::int32_t& foodHeld() { return table().foodHeld[slot()]; }
     static int typeToIID(int type) {
         assert(0 <= type && type < 4);
         static_assert(IID_ANT_TYPE0 + 1 == IID_ANT_TYPE1, "Unexpected IID_ANT_TYPE1 index");
@@ -191,23 +195,42 @@ private:
         static_assert(IID_ANT_TYPE0 + 3 == IID_ANT_TYPE3, "Unexpected IID_ANT_TYPE3 index");
         return IID_ANT_TYPE0 + type;
     }
-    bool evalInstr();
+    friend class StudentWorld;
+    int runBurst(AntDispatch d);
+    int runBurstSwitched(int executed);
+#if BUGS_THREADED_DISPATCH
+    int runBurstThreaded();
+#endif
+    int runBurstTabled();
+    // Called back into by JitProgram and by native code built by bug2cpp.
+    static JitProgram::Callbacks const machineCodeCallbacks;
     bool evalIf(Compiler::Condition cond) const;
+    bool senseIf(Compiler::Condition cond);
+    void performAction(Compiler::Opcode op);
+    void moveForward();
+    void eatFood();
+    void dropFood();
+    void bite();
+    void pickupFood();
+    void generateRandomNumber(int bound);
+    void rotate(int quarterTurns) { setDirection(static_cast<Direction>((getDirection() - up + quarterTurns) % 4 + up)); }
     void moveTo(Coord c) { // Overload not override. No virtual needed.
         assert(c != getCoord());
         Insect::moveTo(c);
-        m_isBitten = false;
+        setFlag(ActorTable::bitten, false);
     }
     int getType() const { return iid() - IID_ANT_TYPE0; }
 };
 
 class Grasshopper : public Insect {
 private:
-    int m_distance;
+    std::int8_t& distance() { return table().distance[slot()]; }
 
 protected:
     template<typename... Args>
-    Grasshopper(Args&&... args) : Insect(std::forward<Args>(args)...), m_distance(randInt(2, 10)) {}
+    Grasshopper(Args&&... args) : Insect(std::forward<Args>(args)...) {
+        distance() = static_cast<std::int8_t>(randInt(2, 10));
+    }
     void consumeFoodAndMove();
 };
 
@@ -231,12 +254,12 @@ private:
         Insect::beBitten(damage);
         if (!isDead() && randInt(0, 1)) {
             // Retaliate.
-            auto insectsHere = findOtherInsectsHere();
-            assert(!insectsHere.empty());
-            static_cast<Actor*>(insectsHere[randInt(0, insectsHere.size() - 1)])->beBitten(50);
+            Insect* biter = pickOtherInsectHere();
+            assert(biter);
+            static_cast<Actor*>(biter)->beBitten(50);
         }
     }
-    std::vector<Coord> findOpenSquaresCenteredHere() const;
+    bool pickOpenSquareCenteredHere(Coord& c) const;
 };
 
 #endif // ACTOR_H_
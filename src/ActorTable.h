@@ -0,0 +1,172 @@
+#ifndef ACTORTABLE_H_
+#define ACTORTABLE_H_
+
+#include "RandomStream.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+class Actor;
+
+// The mutable state of all actors, stored as a structure of arrays indexed by
+// slot. An Actor object owns one slot for its whole lifetime; it keeps only its
+// immutable properties and the GraphObject used to draw it. Not every column
+// is meaningful for every kind of actor: anthills only use the position,
+// direction and energy columns, and only ants use the instruction counter and
+// what follows it.
+//
+// Slots are reused, so code that must refer to an actor across a point where
+// it may be destroyed holds a Handle instead: a slot together with the
+// generation of the slot it was taken at. Each release of a slot bumps its
+// generation, which invalidates all outstanding handles to it.
+class ActorTable {
+public:
+    typedef std::uint32_t Slot;
+    enum : Slot { none = std::numeric_limits<Slot>::max() };
+    struct Handle {
+        Slot slot;
+        std::uint32_t generation;
+    };
+    enum Flag : std::uint8_t {
+        stunnedHere = 1 << 0, // Insects: has been stunned at the current location.
+        blocked = 1 << 1,     // Ants: the last moveForward was blocked.
+        bitten = 1 << 2,      // Ants: has been bitten since the last move.
+        buried = 1 << 3,      // Any: dead and awaiting release; see StudentWorld::buryActor.
+    };
+
+    // Owner, image ID, neighbours in the StudentWorld cell and the sequence
+    // number of the arrival in that cell, for the spatial index.
+    std::vector<Actor*> owner;
+    std::vector<std::uint8_t> iid;
+    std::vector<Slot> prev, next;
+    std::vector<std::uint32_t> arrival;
+
+    std::vector<std::int16_t> x, y;
+    std::vector<std::uint8_t> dir;
+    std::vector<std::int32_t> energy;
+    std::vector<std::int32_t> sleep;
+    std::vector<std::uint8_t> flags;
+    std::vector<std::int8_t> distance;
+    std::vector<std::uint32_t> ic;
+    std::vector<std::int32_t> rand;
+    std::vector<std::int32_t> foodHeld;
+    // The number of the actor among all actors of the match, in order of
+    // creation, how many random numbers it has drawn this tick and the block
+    // they came from; see RandomStream.
+    std::vector<std::uint32_t> id, draws;
+    std::vector<PhiloxCounter> randoms;
+
+    ActorTable() : m_generation{}, m_freeSlots{}, m_remap{} {}
+
+    // Returns a slot with all columns cleared, reusing a released slot if there
+    // is one.
+    Slot allocate() {
+        if (m_freeSlots.empty()) {
+            grow();
+            return static_cast<Slot>(size() - 1);
+        }
+        Slot s = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        clear(s);
+        return s;
+    }
+    void release(Slot s) {
+        assert(s < size());
+        ++m_generation[s];
+        owner[s] = nullptr;
+        m_freeSlots.emplace_back(s);
+    }
+    // Invalidates all outstanding handles to s while keeping its row.
+    void invalidate(Slot s) { ++m_generation[s]; }
+    Handle handle(Slot s) const { return {s, m_generation[s]}; }
+    // Returns the actor the handle was taken for, or nullptr if it is gone.
+    Actor* resolve(Handle h) const { return m_generation[h.slot] == h.generation ? owner[h.slot] : nullptr; }
+    std::size_t size() const { return x.size(); }
+    std::size_t live() const { return size() - m_freeSlots.size(); }
+    void reset() {
+        resize(0);
+        m_freeSlots.clear();
+    }
+    // Moves the rows of the given slots to the front of the table, in the given
+    // order, and drops all other rows. Afterwards, remapped() translates a slot
+    // from before the compaction to the slot its row has moved to.
+    void compact(std::vector<Slot> const& order) {
+        m_remap.assign(size(), none);
+        for (std::size_t i = 0; i < order.size(); ++i) m_remap[order[i]] = static_cast<Slot>(i);
+        auto gather = [&order](auto& column) {
+            std::remove_reference_t<decltype(column)> moved(order.size());
+            for (std::size_t i = 0; i < order.size(); ++i) moved[i] = column[order[i]];
+            column.swap(moved);
+        };
+        gather(m_generation);
+        gather(owner);
+        gather(iid);
+        gather(prev);
+        gather(next);
+        gather(arrival);
+        gather(x);
+        gather(y);
+        gather(dir);
+        gather(energy);
+        gather(sleep);
+        gather(flags);
+        gather(distance);
+        gather(ic);
+        gather(rand);
+        gather(foodHeld);
+        gather(id);
+        gather(draws);
+        gather(randoms);
+        for (Slot& s : prev) s = remapped(s);
+        for (Slot& s : next) s = remapped(s);
+        m_freeSlots.clear();
+    }
+    Slot remapped(Slot s) const { return s == none ? none : m_remap[s]; }
+
+private:
+    std::vector<std::uint32_t> m_generation;
+    std::vector<Slot> m_freeSlots;
+    std::vector<Slot> m_remap;
+
+    void resize(std::size_t n) {
+        m_generation.resize(n);
+        owner.resize(n);
+        iid.resize(n);
+        prev.resize(n, none);
+        next.resize(n, none);
+        arrival.resize(n);
+        x.resize(n);
+        y.resize(n);
+        dir.resize(n);
+        energy.resize(n);
+        sleep.resize(n);
+        flags.resize(n);
+        distance.resize(n);
+        ic.resize(n);
+        rand.resize(n);
+        foodHeld.resize(n);
+        id.resize(n);
+        draws.resize(n);
+        randoms.resize(n);
+    }
+    void grow() { resize(size() + 1); }
+    void clear(Slot s) {
+        owner[s] = nullptr;
+        iid[s] = 0;
+        prev[s] = next[s] = none;
+        arrival[s] = 0;
+        x[s] = y[s] = 0;
+        dir[s] = flags[s] = 0;
+        energy[s] = sleep[s] = rand[s] = 0;
+        distance[s] = 0;
+        ic[s] = 0;
+        foodHeld[s] = 0;
+        id[s] = draws[s] = 0;
+        randoms[s] = {};
+    }
+};
+
+#endif // ACTORTABLE_H_
@@ -3,11 +3,16 @@
 
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <string>
 #include <vector>
-#include <map>
+#include <array>
 #include <algorithm>
+#include <cassert>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
 #include "GameConstants.h"
 
@@ -29,7 +34,8 @@ public:
 		pickupFood,
 		dropFood,
 		eatFood,
-		generateRandomNumber
+		generateRandomNumber,
+		clearRandomNumber	// only produced by the optimizer; see optimize()
 	};
 
 	enum Condition
@@ -56,6 +62,19 @@ public:
 		int lineNum;
 	};
 
+	// A command as executed by an ant: labels are gone, and the operand is
+	// already an integer (the instruction number to jump to for goto and if,
+	// or the upper bound for generateRandomNumber). cost is the number of
+	// commands of the source program that a jump to operand stands for.
+	struct Instruction
+	{
+		std::int8_t		opcode;		// an Opcode
+		std::int8_t		condition;	// a Condition, for if_command
+		std::uint8_t	cost;
+		std::int32_t	operand;
+	};
+	static_assert(sizeof(Instruction) == 8, "Instruction should pack into 8 bytes");
+
 	Compiler()
 	{
 		m_colonyName = "--------";
@@ -65,327 +84,727 @@ public:
 
 	bool compile(std::string sourceFile, std::string& firstError)
 	{
-		m_labelToLine.clear();
-		m_outputProgram.clear();
+		std::string path, source;
+		if ( ! readSource(sourceFile, path, source))
+		{
+			firstError = "Cannot open file";
+			return false;
+		}
+		return compileSource(source, firstError);
+	}
 
-		std::ifstream inf;
+	// Read the bug program named sourceFile, trying the same suffixes as
+	// compile(), into source, and set path to the name of the file read
+	static bool readSource(std::string sourceFile, std::string& path, std::string& source)
+	{
 		for (auto suffix : { "", ".bug", ".txt", ".bug.txt" })
 		{
-			inf.open(sourceFile + suffix);
+			std::ifstream inf(sourceFile + suffix, std::ios::binary);
 			if (inf)
-				break;
-		}
-		if ( ! inf)
-		{
-			firstError = "Cannot open file";
-			return false;
+			{
+				path = sourceFile + suffix;
+				std::streamoff size = inf.seekg(0, std::ios::end).tellg();
+				if (size >= 0  &&  inf.seekg(0))
+				{
+					source.resize(static_cast<size_t>(size));
+					inf.read(&source[0], size);
+					source.resize(static_cast<size_t>(inf.gcount()));
+				}
+				else
+				{
+					inf.clear();
+					source.assign(std::istreambuf_iterator<char>(inf), std::istreambuf_iterator<char>());
+				}
+				return true;
+			}
 		}
+		return false;
+	}
 
-		std::string colonyName;
-		if ( ! getline(inf, colonyName))
+	// Compile the text of a bug program, as read by readSource().  The text
+	// is scanned in place: tokens point into it, keywords are found by a
+	// perfect hash and labels in a hash table of tokens, so nothing is
+	// allocated per line or per token.
+	bool compileSource(const std::string& source, std::string& firstError)
+	{
+		m_source = source;
+		m_commands.clear();
+		m_instructions.clear();
+		m_optimized.clear();
+		m_segments.clear();
+		m_outcomes.clear();
+
+		const char* const begin = m_source.data();
+		const char* const end = begin + m_source.size();
+		if (begin == end)
 		{
 			firstError = "File is empty";
 			return false;
 		}
-		std::vector<std::string> tokens = tokenize(colonyName);
-		if (tokens.size() < 2 || tokens[0] != "colony:")
+
+		Token tokens[MAX_TOKENS_PER_LINE];
+		const char* lineEnd = findLineEnd(begin, end);
+		size_t numTokens = tokenize(begin, lineEnd, tokens);
+		if (numTokens < 2 || ! equals(tokens[0], "colony:"))
 		{
 			firstError = "Invalid colony specification at top of bug program";
 			return false;
 		}
-		m_colonyName = (tokens[1].size() <= 8 ? tokens[1] : tokens[1].substr(0,8));
+		m_colonyName = lowered(tokens[1]).substr(0,8);
 
+		LabelTable labels;
 		int lineNum = 0;
-		std::string line;
-		while (getline(inf, line))
+		for (const char* line = lineEnd; line != end  &&  ++line != end; line = lineEnd)
 		{
+			lineEnd = findLineEnd(line, end);
 			lineNum++;
-			Command c;
-			ParseResult pr = parseLine(line, c, lineNum, firstError);
-
-			if (pr == error_line)
+			numTokens = tokenize(line, lineEnd, tokens);
+			if (numTokens == 0)
+				continue;
+
+			SourceCommand c;
+			c.lineNum = lineNum;
+			c.offset = static_cast<std::uint32_t>(line - begin);
+			c.size = static_cast<std::uint32_t>(lineEnd - line);
+			Token target = { nullptr, 0 };
+			if ( ! parseLine(tokens, numTokens, c, target, firstError))
 				return false;
-			else if (pr == valid_line)
+
+			if (c.instruction.opcode != label)
 			{
-				if (c.opcode != Opcode::label)
-					m_outputProgram.push_back(c);
-				else
-				{
-					auto p = m_labelToLine.find(c.operand1);
-					if (p != m_labelToLine.end())
-					{
-						firstError = "Line ";
-						firstError += std::to_string(lineNum);
-						firstError += " has label ";
-						firstError += c.operand1;
-						firstError += " duplicating label on line ";
-						firstError += std::to_string(p->second);
-						return false;
-					}
-					m_labelToLine[c.operand1] = m_outputProgram.size(); // map each label to its proper location
-				}
+				c.targetOffset = static_cast<std::uint32_t>(target.text ? target.text - begin : 0);
+				c.targetSize = static_cast<std::uint32_t>(target.size);
+				m_commands.push_back(c);
+				continue;
 			}
+			const LabelTable::Entry& previous = labels.find(target);
+			if (previous.name.text)
+			{
+				firstError = "Line ";
+				firstError += std::to_string(lineNum);
+				firstError += " has label ";
+				firstError += lowered(target);
+				firstError += " duplicating label on line ";
+				firstError += std::to_string(previous.command);
+				return false;
+			}
+			labels.insert(target, m_commands.size()); // map each label to its proper location
 		}
 
-		// replace goto target labels with command numbers
+		// replace goto target labels with command numbers, and pack the
+		// commands for execution
 
-		for (size_t i = 0; i < m_outputProgram.size(); ++i)
+		m_instructions.reserve(m_commands.size());
+		for (SourceCommand& c : m_commands)
 		{
-			if (m_outputProgram[i].opcode == Opcode::goto_command)
+			if (c.instruction.opcode == goto_command  ||  c.instruction.opcode == if_command)
 			{
-				auto p = m_labelToLine.find(m_outputProgram[i].operand1);
-				if (p != m_labelToLine.end())
-					m_outputProgram[i].operand1 = std::to_string(p->second);
-				else
+				const Token target = { begin + c.targetOffset, c.targetSize };
+				const LabelTable::Entry& l = labels.find(target);
+				if ( ! l.name.text)
 				{
 					firstError = "Line ";
-					firstError += std::to_string(m_outputProgram[i].lineNum);
+					firstError += std::to_string(c.lineNum);
 					firstError += " has goto to unknown label ";
-					firstError += m_outputProgram[i].operand1;
+					firstError += lowered(target);
 					return false;
 				}
+				c.instruction.operand = static_cast<std::int32_t>(l.command);
 			}
-			else if (m_outputProgram[i].opcode == if_command)
+			m_instructions.push_back(c.instruction);
+		}
+
+		optimize();
+		tabulate();
+		return true;
+	}
+
+	// Use a program that was compiled before, such as the one carried by a
+	// shared object built by bug2cpp, as if it had just been compiled.
+	bool load(std::string colonyName, const Instruction* instructions, size_t size, std::string& firstError)
+	{
+		m_source.clear();
+		m_commands.clear();
+		m_optimized.clear();
+		m_segments.clear();
+		m_outcomes.clear();
+		m_colonyName = colonyName.substr(0,8);
+		m_instructions.assign(instructions, instructions + size);
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			const Instruction& instr = m_instructions[i];
+			bool valid = instr.opcode >= goto_command  &&  instr.opcode <= generateRandomNumber;
+			if (instr.opcode == goto_command  ||  instr.opcode == if_command)
+				valid = valid  &&  instr.operand >= 0  &&  static_cast<size_t>(instr.operand) <= size;
+			if (instr.opcode == if_command)
+				valid = valid  &&  instr.condition >= i_smell_danger_in_front_of_me  &&
+						instr.condition <= last_random_number_was_zero;
+			if ( ! valid)
 			{
-				auto p = m_labelToLine.find(m_outputProgram[i].operand2);
-				if (p != m_labelToLine.end())
-					m_outputProgram[i].operand2 = std::to_string(p->second);
-				else
-				{
-					firstError = "Line ";
-					firstError += std::to_string(m_outputProgram[i].lineNum);
-					firstError += " has goto to unknown label ";
-					firstError += m_outputProgram[i].operand2;
-					return false;
-				}
+				firstError = "Instruction ";
+				firstError += std::to_string(i);
+				firstError += " is invalid";
+				m_instructions.clear();
+				return false;
 			}
 		}
 
+		optimize();
+		tabulate();
 		return true;
 	}
 
+	// The program as written, without the commands no ant can reach.
+	const std::vector<Instruction>& getInstructions() const { return m_instructions; }
+
+	// The same program with jumps threaded, numbered the same way. A jump in
+	// it with a cost above 1 must only be taken if the ant may still execute
+	// that many commands this tick; otherwise the ant must execute the
+	// instruction at the same position in getInstructions() instead.
+	const std::vector<Instruction>& getOptimizedInstructions() const { return m_optimized; }
+
+	// Until it executes an action or generateRandomNumber, an ant only
+	// consults conditions, none of which can change in the meantime. So what
+	// happens from a given instruction, with a given number of commands left
+	// for this tick, is a function of the conditions it may consult on the
+	// way, and is tabulated ahead of time as a segment with one outcome for
+	// each combination of those conditions.
+	enum SegmentEnd
+	{
+		act,		// executed the action at, and is done for this tick
+		generate,	// executed the generateRandomNumber at, and goes on from the next instruction
+		exhausted,	// ran out of commands for this tick, and resumes at at
+		fellOff		// ran off the end of the program, which at is
+	};
+	struct Outcome
+	{
+		std::uint8_t	end;		// a SegmentEnd
+		std::uint8_t	consumed;	// commands executed, including any at at
+		std::int32_t	at;
+	};
+	struct Segment
+	{
+		std::uint16_t	conditions;	// one bit per Condition consulted, or NOT_TABULATED
+		std::uint32_t	first;		// index of the outcome for all of them being false
+	};
+	static const std::uint16_t NOT_TABULATED = 0xffff;
+
+	const Segment& getSegment(int pc, int commandsLeft) const
+	{
+		static const Segment notTabulated = { NOT_TABULATED, 0 };
+		if (m_segments.empty())
+			return notTabulated;
+		return m_segments[pc * MAX_COMMANDS_PER_TICK + commandsLeft - 1];
+	}
+	// index has one bit per condition of the segment, in increasing order of
+	// Condition, set if that condition holds.
+	const Outcome& getOutcome(const Segment& segment, unsigned index) const
+	{
+		return m_outcomes[segment.first + index];
+	}
+
 	bool getCommand(int lineNumber, Command& c) const
 	{
-		if (lineNumber < 0  ||  lineNumber >= static_cast<int>(m_outputProgram.size()))
+		if (lineNumber < 0  ||  lineNumber >= static_cast<int>(m_commands.size()))
 			return false;
 
-		c = m_outputProgram[lineNumber];
+		const SourceCommand& sc = m_commands[lineNumber];
+		const char* line = m_source.data() + sc.offset;
+		Token tokens[MAX_TOKENS_PER_LINE];
+		tokenize(line, line + sc.size, tokens);
+		c.opcode = static_cast<Opcode>(sc.instruction.opcode);
+		c.operand1.clear();
+		c.operand2.clear();
+		if (c.opcode == if_command)
+		{
+			c.operand1 = std::to_string(sc.instruction.condition);
+			c.operand2 = std::to_string(sc.instruction.operand);
+		}
+		else if (c.opcode == goto_command)
+			c.operand1 = std::to_string(sc.instruction.operand);
+		else if (c.opcode == generateRandomNumber)
+			c.operand1 = lowered(tokens[1]);
+		c.text.assign(line, sc.size);
+		c.lineNum = sc.lineNum;
 		return true;
 	}
 
 private:
 
-	enum ParseResult {
-		empty_line, valid_line, error_line
-	};
+	// An ant executes at most this many commands per tick, so no longer chain
+	// of jumps is worth threading.
+	static const int MAX_COMMANDS_PER_TICK = 10;
 
-	ParseResult parseLine(std::string line, Command& c, int lineNum, std::string& firstError)
+	void optimize()
 	{
-		c.lineNum = lineNum;
-		c.text = line;
+		const int size = static_cast<int>(m_instructions.size());
 
-		std::vector<std::string> tokens = tokenize(line);
-		if (tokens.empty())
-			return empty_line;
+		// remove the commands that cannot be reached from the first one,
+		// following jumps and falling through from everything but goto
 
-		if (tokens.size() < MIN_TOKENS_PER_LINE)
+		std::vector<int> newIndex(size + 1, -1);
+		std::vector<int> pending(1, 0);
+		while ( ! pending.empty())
 		{
-			firstError = "Line ";
-			firstError += std::to_string(lineNum);
-			firstError += " has an incomplete command";
-			return error_line;
+			int i = pending.back();
+			pending.pop_back();
+			if (i >= size  ||  newIndex[i] != -1)
+				continue;
+			newIndex[i] = 0;
+			const Instruction& instr = m_instructions[i];
+			if (instr.opcode == goto_command  ||  instr.opcode == if_command)
+				pending.push_back(instr.operand);
+			if (instr.opcode != goto_command)
+				pending.push_back(i + 1);
 		}
+		int kept = 0;
+		for (int i = 0; i < size; ++i)
+			if (newIndex[i] != -1)
+				newIndex[i] = kept++;
+		newIndex[size] = kept;
+
+		std::vector<Instruction> reachable;
+		reachable.reserve(kept);
+		for (int i = 0; i < size; ++i)
+			if (newIndex[i] != -1)
+			{
+				Instruction instr = m_instructions[i];
+				if (instr.opcode == goto_command  ||  instr.opcode == if_command)
+					instr.operand = newIndex[std::min(static_cast<int>(instr.operand), size)];
+				reachable.push_back(instr);
+			}
+		m_instructions.swap(reachable);
 
-		bool validNumberOfOperands = false;
-		c.opcode = getOpcodeForCommand(tokens[0], tokens.size(), validNumberOfOperands);
+		// thread jumps through gotos, and through ifs whose outcome is known;
+		// generateRandomNumber 1 always sets the last random number to zero,
+		// so it becomes a jump that does so
 
-		if (c.opcode == invalid)
+		m_optimized = m_instructions;
+		for (int i = 0; i < kept; ++i)
 		{
-			firstError = "Line ";
-			firstError += std::to_string(lineNum);
-			firstError += " has an invalid command: ";
-			firstError += tokens[0];
-			return error_line;
+			Instruction& instr = m_optimized[i];
+			if (instr.opcode == goto_command  ||  instr.opcode == if_command)
+				threadJump(instr, false);
+			else if (instr.opcode == generateRandomNumber  &&  instr.operand == 1)
+			{
+				instr.opcode = clearRandomNumber;
+				instr.operand = i + 1;
+				threadJump(instr, true);
+			}
 		}
+	}
 
-		if (!validNumberOfOperands)
-		{
-			firstError = "Line ";
-			firstError += std::to_string(lineNum);
-			firstError += " has the wrong number of operands for the command ";
-			firstError += tokens[0];
-			return error_line;
-		}
+	// Segments consulting more conditions than this are not worth their
+	// table; ants run them through the interpreter instead.
+	static const int MAX_TABULATED_CONDITIONS = 6;
 
-		if (c.opcode == if_command)
-		{
-			Condition cond = getIfOpcode(tokens[1]);
-			if (cond == Condition::invalid_if)
+	// Nor are programs longer than this, such as generated ones, whose table
+	// would take long to build and far more memory than the program.
+	static const int MAX_TABULATED_INSTRUCTIONS = 1 << 14;
+
+	void tabulate()
+	{
+		const int size = static_cast<int>(m_instructions.size());
+		if (size > MAX_TABULATED_INSTRUCTIONS)
+			return;
+		for (int pc = 0; pc < size; ++pc)
+			for (int left = 1; left <= MAX_COMMANDS_PER_TICK; ++left)
 			{
-				firstError = "Line ";
-				firstError += std::to_string(lineNum);
-				firstError += " has invalid if condition: ";
-				firstError += tokens[1];
-				return error_line;
+				Segment segment = { 0, static_cast<std::uint32_t>(m_outcomes.size()) };
+				collectConditions(pc, left, 0, 0, segment.conditions);
+
+				std::vector<unsigned> bits;
+				for (unsigned c = 0; c <= last_random_number_was_zero; ++c)
+					if (segment.conditions >> c & 1)
+						bits.push_back(c);
+				if (bits.size() > static_cast<size_t>(MAX_TABULATED_CONDITIONS))
+					segment.conditions = NOT_TABULATED;
+				else
+				{
+					for (unsigned index = 0; index < (1u << bits.size()); ++index)
+					{
+						unsigned values = 0;
+						for (size_t b = 0; b < bits.size(); ++b)
+							values |= (index >> b & 1) << bits[b];
+						m_outcomes.push_back(runSegment(pc, left, values));
+					}
+				}
+				m_segments.push_back(segment);
 			}
-			c.operand1 = std::to_string(cond); // condition number as string
-			c.operand2 = tokens[4]; // target label
-		}
-		else if (c.opcode == goto_command)
-		{
-			c.operand1 = tokens[1];
-		}
-		else if (c.opcode == generateRandomNumber)
+	}
+
+	// Adds to conditions every condition that may be consulted from pc within
+	// left commands, given the values already assumed for those in known.
+	void collectConditions(int pc, int left, unsigned known, unsigned values, std::uint16_t& conditions) const
+	{
+		const int size = static_cast<int>(m_instructions.size());
+		for (; left > 0  &&  pc < size; --left)
 		{
-			if (stoi(tokens[1]) > 0)
-				c.operand1 = tokens[1];
-			else
+			const Instruction& instr = m_instructions[pc];
+			if (instr.opcode == goto_command)
+				pc = instr.operand;
+			else if (instr.opcode == if_command)
 			{
-				firstError = "Line ";
-				firstError += std::to_string(lineNum);
-				firstError += " operand must be an integer greater than zero";
-				return error_line;
+				unsigned bit = 1u << instr.condition;
+				if ( ! (known & bit))
+				{
+					conditions |= bit;
+					collectConditions(instr.operand, left - 1, known | bit, values | bit, conditions);
+					known |= bit;
+				}
+				pc = (values & bit) ? instr.operand : pc + 1;
 			}
+			else
+				return;
 		}
-		else if (c.opcode == label)
+	}
+
+	Outcome runSegment(int pc, int left, unsigned values) const
+	{
+		const int size = static_cast<int>(m_instructions.size());
+		for (int consumed = 0; ; ++consumed)
 		{
-			// remove colon from label
-			c.operand1 = tokens[0].substr(0, tokens[0].size() - 1);
+			if (consumed == left)
+				return { exhausted, static_cast<std::uint8_t>(consumed), pc };
+			if (pc >= size)
+				return { fellOff, static_cast<std::uint8_t>(consumed), pc };
+			const Instruction& instr = m_instructions[pc];
+			if (instr.opcode == goto_command)
+				pc = instr.operand;
+			else if (instr.opcode == if_command)
+				pc = (values >> instr.condition & 1) ? instr.operand : pc + 1;
+			else
+				return { static_cast<std::uint8_t>(instr.opcode == generateRandomNumber ? generate : act),
+						 static_cast<std::uint8_t>(consumed + 1), pc };
 		}
-
-		return valid_line;
 	}
 
-	std::vector<std::string> tokenize(const std::string& line)
+	void threadJump(Instruction& jump, bool randomIsZero) const
 	{
-		std::string curToken;
-		size_t curOff = 0;
-		std::vector<std::string> tokens;
-
-		do
+		const int size = static_cast<int>(m_instructions.size());
+		while (jump.operand < size  &&  jump.cost < MAX_COMMANDS_PER_TICK)
 		{
-			size_t startOfNextToken = line.find_first_not_of(" \t,\r\n", curOff);
-			if (startOfNextToken == std::string::npos)
-				break;
-			if (line.compare(startOfNextToken, 2, "//") == 0)
+			const Instruction& next = m_instructions[jump.operand];
+			if (next.opcode == goto_command  ||
+				(next.opcode == if_command  &&  randomIsZero  &&  next.condition == last_random_number_was_zero))
+				jump.operand = next.operand;
+			else if (next.opcode == generateRandomNumber  &&  next.operand == 1  &&  randomIsZero)
+				jump.operand++;
+			else
 				break;
-			size_t startOfWhiteSpace = line.find_first_of(" \t,\r\n", startOfNextToken + 1);
-			if (startOfWhiteSpace == std::string::npos)
-				startOfWhiteSpace = line.size();
+			jump.cost++;
+		}
+	}
 
-			tokens.push_back(line.substr(startOfNextToken, startOfWhiteSpace - startOfNextToken));
-			std::string& data = tokens.back();
-			std::transform(data.begin(), data.end(), data.begin(), ::tolower);
+	// A token of a bug program: a run of characters in the source, which is
+	// never copied.  Keywords and labels are compared ignoring case.
+	struct Token
+	{
+		const char* text;
+		size_t size;
+	};
 
-			curOff = startOfWhiteSpace + 1;
-		} while (curOff < line.size());
+	// Commands never have more than this many tokens; tokenize() counts any
+	// further ones without storing them.
+	static const size_t MAX_TOKENS_PER_LINE = 5;
 
-		return tokens;
+	// A command of the source program, as parsed: its instruction, with the
+	// target label of a goto or if until it is resolved, and where it is in
+	// the source.
+	struct SourceCommand
+	{
+		Instruction		instruction;
+		int				lineNum;
+		std::uint32_t	offset, size;
+		std::uint32_t	targetOffset, targetSize;
+	};
+
+	static char lower(char c)
+	{
+		return c >= 'A'  &&  c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
 	}
 
-	Opcode getOpcodeForCommand(const std::string& c, size_t numTokens, bool& validNumberOfOperands)
+	static std::string lowered(const Token& t)
 	{
-		validNumberOfOperands = false;
+		std::string s(t.text, t.size);
+		for (char& c : s)
+			c = lower(c);
+		return s;
+	}
 
-		if (c == "moveforward")
-		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::moveForward;
-		}
-		else if (c == "emitpheromone")
-		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::emitPheromone;
-		}
-		else if (c == "facerandomdirection")
+	static bool equals(const Token& t, const char* lowercase)
+	{
+		for (size_t i = 0; i < t.size; ++i)
+			if (lowercase[i] == '\0'  ||  lower(t.text[i]) != lowercase[i])
+				return false;
+		return lowercase[t.size] == '\0';
+	}
+
+	static bool equals(const Token& a, const Token& b)
+	{
+		if (a.size != b.size)
+			return false;
+		for (size_t i = 0; i < a.size; ++i)
+			if (lower(a.text[i]) != lower(b.text[i]))
+				return false;
+		return true;
+	}
+
+	static const char* findLineEnd(const char* line, const char* end)
+	{
+		const void* newline = std::memchr(line, '\n', end - line);
+		return newline ? static_cast<const char*>(newline) : end;
+	}
+
+	static bool isSeparator(char c)
+	{
+		return c == ' '  ||  c == '\t'  ||  c == ','  ||  c == '\r'  ||  c == '\n';
+	}
+
+	// Split the line into tokens, stopping at a token that starts with //,
+	// store the first MAX_TOKENS_PER_LINE of them, and return how many there
+	// are in all
+	static size_t tokenize(const char* p, const char* end, Token* tokens)
+	{
+		size_t numTokens = 0;
+		for (;;)
 		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::faceRandomDirection;
+			while (p != end  &&  isSeparator(*p))
+				p++;
+			if (p == end  ||  (end - p >= 2  &&  p[0] == '/'  &&  p[1] == '/'))
+				return numTokens;
+			const char* start = p;
+			while (p != end  &&  ! isSeparator(*p))
+				p++;
+			if (numTokens < MAX_TOKENS_PER_LINE)
+				tokens[numTokens] = { start, static_cast<size_t>(p - start) };
+			numTokens++;
 		}
-		else if (c == "rotateclockwise")
+	}
+
+	// Parse the command on a line that has tokens, setting target to the label
+	// it jumps to or, for a label, defines
+	bool parseLine(const Token* tokens, size_t numTokens, SourceCommand& c, Token& target, std::string& firstError)
+	{
+		Opcode opcode = findOpcode(tokens[0]);
+		if (opcode == invalid  &&  tokens[0].size >= 2  &&  tokens[0].text[tokens[0].size - 1] == ':')
+			opcode = label;
+
+		if (opcode == invalid)
 		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::rotateClockwise;
+			firstError = "Line ";
+			firstError += std::to_string(c.lineNum);
+			firstError += " has an invalid command: ";
+			firstError += lowered(tokens[0]);
+			return false;
 		}
-		else if (c == "rotatecounterclockwise")
+
+		size_t operands = 0;
+		if (opcode == if_command)
+			operands = 4;
+		else if (opcode == goto_command  ||  opcode == generateRandomNumber)
+			operands = 1;
+		if (numTokens != operands + 1)
 		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::rotateCounterClockwise;
+			firstError = "Line ";
+			firstError += std::to_string(c.lineNum);
+			firstError += " has the wrong number of operands for the command ";
+			firstError += lowered(tokens[0]);
+			return false;
 		}
-		else if (c == "bite")
+
+		c.instruction = { static_cast<std::int8_t>(opcode), Condition::invalid_if, 1, 0 };
+		if (opcode == if_command)
 		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::bite;
+			Condition cond = findCondition(tokens[1]);
+			if (cond == Condition::invalid_if)
+			{
+				firstError = "Line ";
+				firstError += std::to_string(c.lineNum);
+				firstError += " has invalid if condition: ";
+				firstError += lowered(tokens[1]);
+				return false;
+			}
+			c.instruction.condition = static_cast<std::int8_t>(cond);
+			target = tokens[4];
 		}
-		else if (c == "pickupfood")
+		else if (opcode == goto_command)
+			target = tokens[1];
+		else if (opcode == generateRandomNumber)
 		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::pickupFood;
+			int bound;
+			if ( ! parseInt(tokens[1], bound)  ||  bound <= 0)
+			{
+				firstError = "Line ";
+				firstError += std::to_string(c.lineNum);
+				firstError += " operand must be an integer greater than zero";
+				return false;
+			}
+			c.instruction.operand = bound;
 		}
-		else if (c == "dropfood")
+		else if (opcode == label)
 		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::dropFood;
+			// remove colon from label
+			target = { tokens[0].text, tokens[0].size - 1 };
 		}
-		else if (c == "eatfood")
+		return true;
+	}
+
+	// Parse the integer at the start of the token, as std::stoi would
+	static bool parseInt(const Token& t, int& value)
+	{
+		size_t i = 0;
+		while (i < t.size  &&  std::isspace(static_cast<unsigned char>(t.text[i])))
+			i++;
+		bool negative = false;
+		if (i < t.size  &&  (t.text[i] == '+'  ||  t.text[i] == '-'))
+			negative = t.text[i++] == '-';
+		if (i == t.size  ||  ! std::isdigit(static_cast<unsigned char>(t.text[i])))
+			return false;
+		long long v = 0;
+		for (; i < t.size  &&  std::isdigit(static_cast<unsigned char>(t.text[i])); i++)
 		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::eatFood;
+			v = v * 10 + (t.text[i] - '0');
+			if (v > static_cast<long long>(std::numeric_limits<int>::max()) + 1)
+				return false;
 		}
-		else if (c == "if")
+		v = negative ? -v : v;
+		if (v > std::numeric_limits<int>::max())
+			return false;
+		value = static_cast<int>(v);
+		return true;
+	}
+
+	// Keywords are found by a perfect hash: no two opcodes, and no two
+	// conditions, have the same sum of length and last letter modulo 32
+	struct Keyword
+	{
+		const char* name;
+		int value;
+	};
+	typedef std::array<const Keyword*, 32> KeywordTable;
+
+	static size_t keywordHash(const Token& t)
+	{
+		return (t.size + static_cast<unsigned char>(lower(t.text[t.size - 1]))) % 32;
+	}
+
+	template<size_t N>
+	static KeywordTable makeKeywordTable(const Keyword (&keywords)[N])
+	{
+		KeywordTable table = {};
+		for (const Keyword& k : keywords)
 		{
-			validNumberOfOperands = (numTokens == 5);
-			return Opcode::if_command;
+			const Token t = { k.name, std::strlen(k.name) };
+			assert( ! table[keywordHash(t)]  &&  "keywords must not collide");
+			table[keywordHash(t)] = &k;
 		}
-		else if (c == "goto")
+		return table;
+	}
+
+	static int findKeyword(const KeywordTable& table, const Token& t, int notFound)
+	{
+		const Keyword* k = table[keywordHash(t)];
+		return k  &&  equals(t, k->name) ? k->value : notFound;
+	}
+
+	static Opcode findOpcode(const Token& t)
+	{
+		static const Keyword keywords[] = {
+			{ "moveforward", moveForward },
+			{ "emitpheromone", emitPheromone },
+			{ "facerandomdirection", faceRandomDirection },
+			{ "rotateclockwise", rotateClockwise },
+			{ "rotatecounterclockwise", rotateCounterClockwise },
+			{ "bite", bite },
+			{ "pickupfood", pickupFood },
+			{ "dropfood", dropFood },
+			{ "eatfood", eatFood },
+			{ "if", if_command },
+			{ "goto", goto_command },
+			{ "generaterandomnumber", generateRandomNumber }
+		};
+		static const KeywordTable table = makeKeywordTable(keywords);
+		return static_cast<Opcode>(findKeyword(table, t, invalid));
+	}
+
+	static Condition findCondition(const Token& t)
+	{
+		static const Keyword keywords[] = {
+			{ "i_smell_pheromone_in_front_of_me", i_smell_pheromone_in_front_of_me },
+			{ "i_smell_danger_in_front_of_me", i_smell_danger_in_front_of_me },
+			{ "i_was_bit", i_was_bit },
+			{ "i_am_carrying_food", i_am_carrying_food },
+			{ "i_am_hungry", i_am_hungry },
+			{ "i_am_standing_on_my_anthill", i_am_standing_on_my_anthill },
+			{ "i_am_standing_on_food", i_am_standing_on_food },
+			{ "i_am_standing_with_an_enemy", i_am_standing_with_an_enemy },
+			{ "i_was_blocked_from_moving", i_was_blocked_from_moving },
+			{ "last_random_number_was_zero", last_random_number_was_zero }
+		};
+		static const KeywordTable table = makeKeywordTable(keywords);
+		return static_cast<Condition>(findKeyword(table, t, invalid_if));
+	}
+
+	// The labels of the program being compiled, by name without the colon:
+	// an open addressing hash table of tokens, kept at most half full
+	class LabelTable
+	{
+	public:
+		struct Entry
 		{
-			validNumberOfOperands = (numTokens == 2);
-			return Opcode::goto_command;
-		}
-		else if (c == "generaterandomnumber")
+			Token name;		// name.text is null if the entry is free
+			size_t command;
+		};
+
+		LabelTable() : m_entries(64), m_size(0) {}
+
+		// Return the entry for the label, or the free entry it would go in
+		const Entry& find(const Token& name) const
 		{
-			validNumberOfOperands = (numTokens == 2);
-			return Opcode::generateRandomNumber;
+			return m_entries[slot(m_entries, name)];
 		}
-		else if (c.size() >= 2 && c.back() == ':')
+
+		void insert(const Token& name, size_t command)
 		{
-			validNumberOfOperands = (numTokens == 1);
-			return Opcode::label;
+			if (2 * (m_size + 1) > m_entries.size())
+			{
+				std::vector<Entry> entries(2 * m_entries.size());
+				for (const Entry& e : m_entries)
+					if (e.name.text)
+						entries[slot(entries, e.name)] = e;
+				m_entries.swap(entries);
+			}
+			m_entries[slot(m_entries, name)] = { name, command };
+			m_size++;
 		}
 
-		return Opcode::invalid;
-	}
+	private:
+		std::vector<Entry>	m_entries;
+		size_t				m_size;
 
-	Condition getIfOpcode(const std::string& s)
-	{
-		if (s == "i_smell_pheromone_in_front_of_me")
-			return i_smell_pheromone_in_front_of_me;
-		if (s == "i_smell_danger_in_front_of_me")
-			return i_smell_danger_in_front_of_me;
-		if (s == "i_was_bit")
-			return i_was_bit;
-		if (s == "i_am_carrying_food")
-			return i_am_carrying_food;
-		if (s == "i_am_hungry")
-			return i_am_hungry;
-		if (s == "i_am_standing_on_my_anthill")
-			return i_am_standing_on_my_anthill;
-		if (s == "i_am_standing_on_food")
-			return i_am_standing_on_food;
-		if (s == "i_am_standing_with_an_enemy")
-			return i_am_standing_with_an_enemy;
-		if (s == "i_was_blocked_from_moving")
-			return i_was_blocked_from_moving;
-		if (s == "last_random_number_was_zero")	
-			return last_random_number_was_zero;
-
-		return Condition::invalid_if;
-	}
+		static size_t slot(const std::vector<Entry>& entries, const Token& name)
+		{
+			// 64-bit FNV-1a, ignoring case
+			std::uint64_t h = 0xcbf29ce484222325;
+			for (size_t i = 0; i < name.size; ++i)
+				h = (h ^ static_cast<unsigned char>(lower(name.text[i]))) * 0x100000001b3;
+			const size_t mask = entries.size() - 1;
+			size_t i = static_cast<size_t>(h) & mask;
+			while (entries[i].name.text  &&  ! equals(entries[i].name, name))
+				i = (i + 1) & mask;
+			return i;
+		}
+	};
 
 private:
-	static const int				MIN_TOKENS_PER_LINE = 1;
-	std::map<std::string, size_t>	m_labelToLine;
-	std::vector<Command>			m_outputProgram;
+	std::string						m_source;
+	std::vector<SourceCommand>		m_commands;
+	std::vector<Instruction>		m_instructions;
+	std::vector<Instruction>		m_optimized;
+	std::vector<Segment>			m_segments;
+	std::vector<Outcome>			m_outcomes;
 	std::string						m_colonyName;
 };
 
@@ -1,6 +1,7 @@
 #ifndef GAMECONSTANTS_H_
 #define GAMECONSTANTS_H_
 
+#include <cstdlib>
 #include <random>
 #include <utility>
 
@@ -70,14 +71,27 @@ const int GWSTATUS_LEVEL_ERROR		= 3;
 
 const int NUM_TEST_PARAMS			  = 1;
 
-  // Return a uniformly distributed random int from min to max, inclusive
+  // Return a seed for a random number generator: the value of the BUGS_SEED
+  // environment variable if it is set, so that a game can be replayed, or else
+  // a random one
+inline
+unsigned randomSeed()
+{
+	if (const char* seed = std::getenv("BUGS_SEED"))
+		return static_cast<unsigned>(std::strtoul(seed, nullptr, 10));
+	std::random_device rd;
+	return rd();
+}
+
+  // Return a uniformly distributed random int from min to max, inclusive.
+  // The simulation draws from the generator of its StudentWorld instead, so
+  // this only serves the framework
 inline
 int randInt(int min, int max)
 {
 	if (max < min)
 		std::swap(max, min);
-	static std::random_device rd;
-	static std::mt19937 generator(rd());
+	static std::mt19937 generator(randomSeed());
 	std::uniform_int_distribution<> distro(min, max);
 	return distro(generator);
 }
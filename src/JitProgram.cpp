@@ -0,0 +1,170 @@
+#include "JitProgram.h"
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#if BUGS_JIT
+#include <sys/mman.h>
+
+namespace {
+// Just enough of an x86-64 assembler for JitProgram: raw bytes, immediates and
+// 32-bit relative references to labels that may not have been placed yet.
+class Assembler {
+public:
+    explicit Assembler(std::size_t labels) : code{}, m_labels(labels), m_fixups{} {}
+    std::vector<std::uint8_t> code;
+
+    void bytes(std::initializer_list<std::uint8_t> bs) { code.insert(code.end(), bs); }
+    void imm32(std::uint32_t v) {
+        for (int i = 0; i < 4; ++i) code.push_back(static_cast<std::uint8_t>(v >> 8 * i));
+    }
+    void imm64(std::uint64_t v) {
+        imm32(static_cast<std::uint32_t>(v));
+        imm32(static_cast<std::uint32_t>(v >> 32));
+    }
+    void rel32(std::size_t label) {
+        m_fixups.push_back({code.size(), label});
+        imm32(0);
+    }
+    void place(std::size_t label) { m_labels[label] = code.size(); }
+    std::size_t offset(std::size_t label) const { return m_labels[label]; }
+    void align(std::size_t n) {
+        while (code.size() % n) code.push_back(0xcc); // int3
+    }
+    void resolve() {
+        for (auto const& f : m_fixups) {
+            auto rel = static_cast<std::int32_t>(m_labels[f.label] - (f.at + 4));
+            std::memcpy(&code[f.at], &rel, 4);
+        }
+    }
+
+private:
+    struct Fixup {
+        std::size_t at, label;
+    };
+    std::vector<std::size_t> m_labels;
+    std::vector<Fixup> m_fixups;
+};
+} // namespace
+
+// Register use: rbx holds the ant, r13 the pc pointer and r12d the number of
+// instructions executed. All three are callee-saved, so they survive the
+// callbacks, and pushing them keeps the stack 16-byte aligned for the calls.
+JitProgram::JitProgram(std::vector<Compiler::Instruction> const& program, Callbacks const& callbacks)
+  : m_code(nullptr), m_size(0), m_entry(nullptr) {
+    std::size_t const n = program.size();
+    std::size_t const end = n, epilogue = n + 1, table = n + 2;
+    Assembler a(n + 3);
+    auto storePc = [&a](std::size_t pc) {
+        a.bytes({0x41, 0xc7, 0x45, 0x00}); // mov dword [r13], pc
+        a.imm32(static_cast<std::uint32_t>(pc));
+    };
+    auto call = [&a](void const* fn) {
+        a.bytes({0x48, 0x89, 0xdf}); // mov rdi, rbx
+        a.bytes({0x48, 0xb8});       // mov rax, fn
+        a.imm64(reinterpret_cast<std::uintptr_t>(fn));
+        a.bytes({0xff, 0xd0}); // call rax
+    };
+    auto callWith = [&a, &call](void const* fn, std::int32_t arg) {
+        a.bytes({0xbe}); // mov esi, arg
+        a.imm32(static_cast<std::uint32_t>(arg));
+        call(fn);
+    };
+    // Ends the burst at pc if all 10 instructions have been executed.
+    auto checkBudget = [&](std::size_t pc) {
+        a.bytes({0x41, 0x83, 0xfc, 0x0a}); // cmp r12d, 10
+        a.bytes({0x75, 0x0d});             // jne over the next 13 bytes
+        storePc(pc);
+        a.bytes({0xe9}); // jmp epilogue
+        a.rel32(epilogue);
+    };
+
+    a.bytes({0x53, 0x41, 0x54, 0x41, 0x55}); // push rbx; push r12; push r13
+    a.bytes({0x48, 0x89, 0xfb});             // mov rbx, rdi
+    a.bytes({0x49, 0x89, 0xf5});             // mov r13, rsi
+    a.bytes({0x45, 0x31, 0xe4});             // xor r12d, r12d
+    a.bytes({0x41, 0x8b, 0x45, 0x00});       // mov eax, [r13]
+    a.bytes({0x3d});                         // cmp eax, n
+    a.imm32(static_cast<std::uint32_t>(n));
+    a.bytes({0x76, 0x05}); // jbe over the next 5 bytes
+    a.bytes({0xb8});       // mov eax, n
+    a.imm32(static_cast<std::uint32_t>(n));
+    a.bytes({0x48, 0x8d, 0x0d}); // lea rcx, [table]
+    a.rel32(table);
+    a.bytes({0xff, 0x24, 0xc1}); // jmp [rcx + rax * 8]
+
+    for (std::size_t i = 0; i < n; ++i) {
+        Compiler::Instruction const& instr = program[i];
+        a.place(i);
+        checkBudget(i);
+        a.bytes({0x41, 0xff, 0xc4}); // inc r12d
+        switch (static_cast<Compiler::Opcode>(instr.opcode)) {
+        case Compiler::Opcode::goto_command:
+            a.bytes({0xe9}); // jmp target
+            a.rel32(static_cast<std::size_t>(instr.operand));
+            break;
+        case Compiler::Opcode::if_command:
+            callWith(reinterpret_cast<void const*>(callbacks.condition), instr.condition);
+            a.bytes({0x84, 0xc0, 0x0f, 0x85}); // test al, al; jnz target
+            a.rel32(static_cast<std::size_t>(instr.operand));
+            break;
+        case Compiler::Opcode::generateRandomNumber:
+            callWith(reinterpret_cast<void const*>(callbacks.generate), instr.operand);
+            break;
+        case Compiler::Opcode::emitPheromone:
+        case Compiler::Opcode::faceRandomDirection:
+        case Compiler::Opcode::rotateClockwise:
+        case Compiler::Opcode::rotateCounterClockwise:
+        case Compiler::Opcode::moveForward:
+        case Compiler::Opcode::bite:
+        case Compiler::Opcode::pickupFood:
+        case Compiler::Opcode::dropFood:
+        case Compiler::Opcode::eatFood:
+            callWith(reinterpret_cast<void const*>(callbacks.action), instr.opcode);
+            storePc(i + 1);
+            a.bytes({0xe9}); // jmp epilogue
+            a.rel32(epilogue);
+            break;
+        default: return; // Not produced by Compiler::compile(); leave it to the interpreters.
+        }
+    }
+
+    a.place(end);
+    checkBudget(n);
+    call(reinterpret_cast<void const*>(callbacks.fellOff));
+    storePc(n);
+
+    a.place(epilogue);
+    a.bytes({0x44, 0x89, 0xe0});             // mov eax, r12d
+    a.bytes({0x41, 0x5d, 0x41, 0x5c, 0x5b}); // pop r13; pop r12; pop rbx
+    a.bytes({0xc3});                         // ret
+
+    a.align(8);
+    a.place(table);
+    for (std::size_t i = 0; i <= n; ++i) a.imm64(0);
+    a.resolve();
+
+    void* code = mmap(nullptr, a.code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) return;
+    auto base = reinterpret_cast<std::uintptr_t>(code);
+    for (std::size_t i = 0; i <= n; ++i) {
+        std::uint64_t target = base + a.offset(i);
+        std::memcpy(&a.code[a.offset(table) + 8 * i], &target, 8);
+    }
+    std::memcpy(code, a.code.data(), a.code.size());
+    m_code = code;
+    m_size = a.code.size();
+    if (mprotect(code, m_size, PROT_READ | PROT_EXEC) != 0) return;
+    m_entry = reinterpret_cast<Entry>(code);
+}
+
+JitProgram::~JitProgram() {
+    if (m_code) munmap(m_code, m_size);
+}
+#else
+JitProgram::JitProgram(std::vector<Compiler::Instruction> const&, Callbacks const&)
+  : m_code(nullptr), m_size(0), m_entry(nullptr) {}
+
+JitProgram::~JitProgram() {}
+#endif
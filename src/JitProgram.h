@@ -0,0 +1,55 @@
+#ifndef JITPROGRAM_H_
+#define JITPROGRAM_H_
+
+#include "Compiler.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Native code generation for ant programs is only implemented for x86-64 with
+// the System V calling convention, on systems where the code buffer can be
+// mapped with mmap.
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__)) && !defined(BUGS_NO_JIT)
+#define BUGS_JIT 1
+#else
+#define BUGS_JIT 0
+#endif
+
+// An ant program translated to x86-64 machine code. Each instruction becomes a
+// block that checks the 10 instruction budget and then either jumps straight to
+// the block of its target or calls back into the ant for the work it cannot do
+// itself: conditions, actions and random numbers. The translation works from
+// the plain program, one block per instruction, so the accounting is exactly
+// that of the interpreters.
+//
+// If the platform is not supported or the code buffer cannot be mapped,
+// valid() is false and the program must be run by an interpreter instead.
+class JitProgram {
+public:
+    // The callbacks are called with the ant passed to run().
+    struct Callbacks {
+        bool (*condition)(void* ant, int condition);
+        void (*action)(void* ant, int opcode);
+        void (*generate)(void* ant, int bound);
+        void (*fellOff)(void* ant); // Called when the program runs out.
+    };
+
+    JitProgram(std::vector<Compiler::Instruction> const& program, Callbacks const& callbacks);
+    JitProgram(JitProgram const&) = delete;
+    JitProgram& operator=(JitProgram const&) = delete;
+    ~JitProgram();
+
+    bool valid() const { return m_entry != nullptr; }
+    std::size_t codeSize() const { return m_size; }
+    // Runs one burst from instruction *pc, leaving in *pc the instruction to
+    // continue from, and returns the number of instructions executed.
+    int run(void* ant, std::uint32_t* pc) const { return m_entry(ant, pc); }
+
+private:
+    typedef int (*Entry)(void* ant, std::uint32_t* pc);
+    void* m_code;
+    std::size_t m_size;
+    Entry m_entry;
+};
+
+#endif // JITPROGRAM_H_
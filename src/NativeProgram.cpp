@@ -0,0 +1,50 @@
+#include "NativeProgram.h"
+#include <cstddef>
+#include <string>
+
+#if BUGS_NATIVE
+#include <dlfcn.h>
+#endif
+
+bool NativeLibrary::isLibrary(std::string const& fileName) {
+    for (std::string suffix : {".so", ".dylib"}) {
+        std::size_t n = suffix.size();
+        if (fileName.size() > n && !fileName.compare(fileName.size() - n, n, suffix)) return true;
+    }
+    return false;
+}
+
+#if BUGS_NATIVE
+bool NativeLibrary::open(std::string const& fileName, std::string& error) {
+    // Without a slash, dlopen would search the library path instead of the
+    // current directory.
+    std::string path = fileName.find('/') == std::string::npos ? "./" + fileName : fileName;
+    m_handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!m_handle) {
+        error = dlerror();
+        return false;
+    }
+    auto program = static_cast<NativeProgram const*>(dlsym(m_handle, "bugsNativeProgram"));
+    if (!program) {
+        error = "is not an ant program built by bug2cpp";
+        return false;
+    }
+    if (program->abi != NativeProgram::abiVersion) {
+        error = "was built by an incompatible version of bug2cpp";
+        return false;
+    }
+    m_program = program;
+    return true;
+}
+
+NativeLibrary::~NativeLibrary() {
+    if (m_handle) dlclose(m_handle);
+}
+#else
+bool NativeLibrary::open(std::string const&, std::string& error) {
+    error = "Shared objects are not supported on this platform";
+    return false;
+}
+
+NativeLibrary::~NativeLibrary() {}
+#endif
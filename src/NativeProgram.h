@@ -0,0 +1,55 @@
+#ifndef NATIVEPROGRAM_H_
+#define NATIVEPROGRAM_H_
+
+#include "Compiler.h"
+#include "JitProgram.h"
+#include <cstdint>
+#include <string>
+
+// Shared objects are loaded with dlopen, which is only available on POSIX
+// systems.
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(BUGS_NO_NATIVE)
+#define BUGS_NATIVE 1
+#else
+#define BUGS_NATIVE 0
+#endif
+
+// An ant program translated to C++ by bug2cpp and built into a shared object,
+// which exports it under the name bugsNativeProgram. The shared object also
+// carries the packed program it was translated from, numbered the same way,
+// so that Compiler::load() can recreate everything the interpreters need.
+//
+// burst() runs one burst from instruction *pc exactly as the interpreters do,
+// calling back into the ant for everything but jumps, leaves in *pc the
+// instruction to continue from and returns the number of instructions
+// executed.
+struct NativeProgram {
+    // Bumped whenever this structure or the meaning of its fields changes.
+    enum : std::uint32_t { abiVersion = 1 };
+    std::uint32_t abi;
+    char const* colonyName;
+    Compiler::Instruction const* instructions;
+    std::uint32_t size;
+    int (*burst)(void* ant, std::uint32_t* pc, JitProgram::Callbacks const& callbacks);
+};
+
+// A shared object built by bug2cpp, kept open for as long as this exists.
+class NativeLibrary {
+public:
+    NativeLibrary() : m_handle(nullptr), m_program(nullptr) {}
+    NativeLibrary(NativeLibrary const&) = delete;
+    NativeLibrary& operator=(NativeLibrary const&) = delete;
+    ~NativeLibrary();
+
+    // Whether the file name is that of a shared object rather than a bug
+    // program.
+    static bool isLibrary(std::string const& fileName);
+    bool open(std::string const& fileName, std::string& error);
+    NativeProgram const* program() const { return m_program; }
+
+private:
+    void* m_handle;
+    NativeProgram const* m_program;
+};
+
+#endif // NATIVEPROGRAM_H_
@@ -0,0 +1,67 @@
+#ifndef OBJECTPOOL_H_
+#define OBJECTPOOL_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A pool of objects of type T. Storage is carved out of slabs of SlabSize
+// objects each, and destroyed objects go on a free list so that their storage
+// is reused by the next create(). Slabs are only returned to the heap when the
+// pool itself is destroyed, so once a pool has reached its peak occupancy it
+// never allocates again.
+template<typename T, std::size_t SlabSize = 256>
+class ObjectPool {
+private:
+    union Slot {
+        Slot* next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+    std::vector<std::unique_ptr<Slot[]>> m_slabs;
+    Slot* m_free;
+    std::size_t m_live, m_peak;
+
+    void grow() {
+        m_slabs.emplace_back(new Slot[SlabSize]);
+        Slot* slab = m_slabs.back().get();
+        for (std::size_t i = SlabSize; i-- > 0;) {
+            slab[i].next = m_free;
+            m_free = &slab[i];
+        }
+    }
+
+public:
+    ObjectPool() : m_slabs{}, m_free(nullptr), m_live(0), m_peak(0) {}
+    ObjectPool(ObjectPool const&) = delete;
+    ObjectPool& operator=(ObjectPool const&) = delete;
+    ~ObjectPool() { assert(!m_live && "objects outlived their pool"); }
+
+    template<typename... Args>
+    T* create(Args&&... args) {
+        if (!m_free) grow();
+        Slot* s = m_free;
+        m_free = s->next;
+        T* p = new (&s->storage) T(std::forward<Args>(args)...);
+        m_peak = std::max(m_peak, ++m_live);
+        return p;
+    }
+    void destroy(T* p) {
+        assert(m_live > 0);
+        p->~T();
+        Slot* s = reinterpret_cast<Slot*>(p);
+        s->next = m_free;
+        m_free = s;
+        --m_live;
+    }
+
+    std::size_t live() const { return m_live; }
+    std::size_t peak() const { return m_peak; }
+    std::size_t capacity() const { return m_slabs.size() * SlabSize; }
+};
+
+#endif // OBJECTPOOL_H_
@@ -0,0 +1,121 @@
+#include "ProgramCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+struct CacheFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t sourceHash;
+    std::uint64_t sourceSize;
+    std::uint32_t nameSize;
+    std::uint32_t instructionCount;
+};
+char const cacheFileMagic[4] = {'B', 'U', 'G', 'C'};
+// Bumped whenever the layout of the file or of Compiler::Instruction changes.
+std::uint32_t const cacheFileVersion = 1;
+} // namespace
+
+ProgramCache& ProgramCache::instance() {
+    static ProgramCache cache;
+    return cache;
+}
+
+std::shared_ptr<Compiler const> ProgramCache::get(std::string const& fileName, std::string& firstError) {
+    std::string path, source;
+    if (!Compiler::readSource(fileName, path, source)) {
+        firstError = "Cannot open file";
+        return nullptr;
+    }
+    bool cacheFiles;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_programs.find(source);
+        if (it != m_programs.end()) {
+            ++m_statistics.hits;
+            return it->second;
+        }
+        cacheFiles = m_cacheFiles;
+    }
+
+    // Compile without holding the lock. Should another thread compile the same
+    // program meanwhile, the program of whichever finishes first is kept.
+    auto program = std::make_shared<Compiler>();
+    bool loaded = cacheFiles && readCacheFile(path + ".cache", source, *program);
+    if (!loaded) {
+        if (!program->compileSource(source, firstError)) return nullptr;
+        if (cacheFiles) writeCacheFile(path + ".cache", source, *program);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++(loaded ? m_statistics.loaded : m_statistics.compiled);
+    auto inserted = m_programs.emplace(std::move(source), std::move(program));
+    m_statistics.programs = m_programs.size();
+    return inserted.first->second;
+}
+
+void ProgramCache::setCacheFiles(bool enabled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cacheFiles = enabled;
+}
+
+ProgramCache::Statistics ProgramCache::statistics() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+// 64-bit FNV-1a.
+std::uint64_t ProgramCache::hash(std::string const& source) {
+    std::uint64_t h = 0xcbf29ce484222325;
+    for (unsigned char c : source) h = (h ^ c) * 0x100000001b3;
+    return h;
+}
+
+bool ProgramCache::readCacheFile(std::string const& path, std::string const& source, Compiler& program) {
+    std::ifstream in(path, std::ios::binary);
+    CacheFileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof header)) return false;
+    if (std::memcmp(header.magic, cacheFileMagic, sizeof header.magic) || header.version != cacheFileVersion ||
+        header.sourceHash != hash(source) || header.sourceSize != source.size() || header.nameSize > 8 ||
+        header.instructionCount > source.size())
+        return false;
+    std::string name(header.nameSize, '\0');
+    std::vector<Compiler::Instruction> instructions(header.instructionCount);
+    if (!in.read(&name[0], header.nameSize) ||
+        !in.read(reinterpret_cast<char*>(instructions.data()), instructions.size() * sizeof(Compiler::Instruction)) ||
+        in.peek() != std::ifstream::traits_type::eof())
+        return false;
+    std::string error;
+    return program.load(name, instructions.data(), instructions.size(), error);
+}
+
+void ProgramCache::writeCacheFile(std::string const& path, std::string const& source, Compiler const& program) {
+    std::string name = program.getColonyName();
+    auto const& instructions = program.getInstructions();
+    CacheFileHeader header = {{},
+                              cacheFileVersion,
+                              hash(source),
+                              source.size(),
+                              static_cast<std::uint32_t>(name.size()),
+                              static_cast<std::uint32_t>(instructions.size())};
+    std::memcpy(header.magic, cacheFileMagic, sizeof header.magic);
+    // Readers must never see a partly written file, so it is written under a
+    // name of its own and then renamed.
+    std::string temporary = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<char const*>(&header), sizeof header);
+        out.write(name.data(), name.size());
+        out.write(reinterpret_cast<char const*>(instructions.data()),
+                  instructions.size() * sizeof(Compiler::Instruction));
+        if (out.flush()) {
+            out.close();
+            if (std::rename(temporary.c_str(), path.c_str()) == 0) return;
+        }
+    }
+    std::remove(temporary.c_str());
+}
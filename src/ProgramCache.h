@@ -0,0 +1,51 @@
+#ifndef PROGRAMCACHE_H_
+#define PROGRAMCACHE_H_
+
+#include "Compiler.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// The compiled ant programs of the process, keyed by their source, so that
+// every world playing the same program shares one immutable Compiler and only
+// the first compiles it. Looking a program up still reads its file, so that
+// an edited program is recompiled, but neither parses nor compiles it again.
+//
+// With cache files enabled, a program compiled from X.bug is also written to
+// X.bug.cache, together with a hash of its source, and later processes load it
+// from there instead of compiling it while the hash still matches.
+//
+// All members may be called from several threads at once.
+class ProgramCache {
+public:
+    static ProgramCache& instance();
+
+    // Returns the compiled program in the given file, or nullptr with
+    // firstError set as by Compiler::compile() if it does not compile.
+    std::shared_ptr<Compiler const> get(std::string const& fileName, std::string& firstError);
+    void setCacheFiles(bool enabled);
+
+    struct Statistics {
+        std::size_t programs, hits, compiled, loaded;
+    };
+    Statistics statistics();
+
+private:
+    ProgramCache() : m_mutex{}, m_programs{}, m_cacheFiles(false), m_statistics{} {}
+    ProgramCache(ProgramCache const&) = delete;
+    ProgramCache& operator=(ProgramCache const&) = delete;
+
+    static std::uint64_t hash(std::string const& source);
+    static bool readCacheFile(std::string const& path, std::string const& source, Compiler& program);
+    static void writeCacheFile(std::string const& path, std::string const& source, Compiler const& program);
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<Compiler const>> m_programs;
+    bool m_cacheFiles;
+    Statistics m_statistics;
+};
+
+#endif // PROGRAMCACHE_H_
@@ -0,0 +1,79 @@
+#ifndef RANDOMSTREAM_H_
+#define RANDOMSTREAM_H_
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3"), a counter-based random number generator: each 128-bit counter is
+// encrypted under the key into four 32-bit random numbers, independently of
+// any other counter. So whoever knows the counter of a draw can make it,
+// without having made the draws before it.
+typedef std::array<std::uint32_t, 4> PhiloxCounter;
+typedef std::array<std::uint32_t, 2> PhiloxKey;
+
+inline PhiloxCounter philox4x32(PhiloxCounter c, PhiloxKey k) {
+    auto mulhilo = [](std::uint32_t a, std::uint32_t b, std::uint32_t& hi) {
+        std::uint64_t product = std::uint64_t{a} * b;
+        hi = static_cast<std::uint32_t>(product >> 32);
+        return static_cast<std::uint32_t>(product);
+    };
+    for (int round = 0; round < 10; ++round) {
+        if (round) {
+            k[0] += 0x9e3779b9;
+            k[1] += 0xbb67ae85;
+        }
+        std::uint32_t hi0, hi1;
+        std::uint32_t lo0 = mulhilo(0xd2511f53, c[0], hi0);
+        std::uint32_t lo1 = mulhilo(0xcd9e8d57, c[2], hi1);
+        c = {{hi1 ^ c[1] ^ k[0], lo1, hi0 ^ c[3] ^ k[1], lo0}};
+    }
+    return c;
+}
+
+// The random numbers of one actor in one tick of a match, as a uniform random
+// bit generator. The n-th number it returns is word n % 4 of the counter
+// (n / 4, tick, actor) encrypted under the seed of the match, so it does not
+// matter what any other actor drew before, or whether it has drawn yet. The
+// four words of a counter are kept in block, and only every fourth number
+// computes a new one.
+class RandomStream {
+public:
+    typedef std::uint32_t result_type;
+    RandomStream(std::uint32_t seed, std::uint32_t actor, std::uint32_t tick, std::uint32_t& draws,
+                 PhiloxCounter& block)
+      : m_key{{seed, 0x42554753}}, m_actor(actor), m_tick(tick), m_draws(draws), m_block(block) {}
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+    result_type operator()() {
+        if (!(m_draws & 3)) m_block = philox4x32({{m_draws >> 2, m_tick, m_actor, 0}}, m_key);
+        return m_block[m_draws++ & 3];
+    }
+
+private:
+    PhiloxKey m_key;
+    std::uint32_t m_actor, m_tick;
+    std::uint32_t& m_draws;
+    PhiloxCounter& m_block;
+};
+
+// Returns a uniformly distributed random number from 0 to range - 1, by
+// Lemire's multiply-shift method ("Fast random integer generation in an
+// interval"): the upper half of the product of a random word and the range is
+// uniform once the few products whose lower half falls below 2^32 % range are
+// rejected, and the division computing that threshold is only needed when the
+// lower half is below range to begin with.
+template<typename Generator>
+std::uint32_t boundedRandom(Generator& g, std::uint32_t range) {
+    assert(range > 0);
+    std::uint64_t m = std::uint64_t{g()} * range;
+    if (static_cast<std::uint32_t>(m) < range) {
+        std::uint32_t threshold = (0u - range) % range;
+        while (static_cast<std::uint32_t>(m) < threshold) m = std::uint64_t{g()} * range;
+    }
+    return static_cast<std::uint32_t>(m >> 32);
+}
+
+#endif // RANDOMSTREAM_H_
@@ -3,23 +3,87 @@
 #include "Compiler.h"
 #include "Field.h"
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cassert>
+#include <cstdint>
 #include <cstdio>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
+thread_local StudentWorld::TileWork* StudentWorld::currentTile = nullptr;
+
 GameWorld* createStudentWorld(std::string assetDir) { return new StudentWorld(assetDir); }
 
+void writeStudentWorldStatistics(GameWorld* gw, std::ostream& os) {
+    static_cast<StudentWorld*>(gw)->writePoolStatistics(os);
+}
+
+bool setStudentWorldAntDispatch(GameWorld* gw, std::string const& name) {
+    auto sw = static_cast<StudentWorld*>(gw);
+    if (name == "switch")
+        sw->setAntDispatch(AntDispatch::switched);
+    else if (name == "threaded" && BUGS_THREADED_DISPATCH)
+        sw->setAntDispatch(AntDispatch::threaded);
+    else if (name == "table")
+        sw->setAntDispatch(AntDispatch::tabled);
+    else if (name == "jit" && BUGS_JIT)
+        sw->setAntDispatch(AntDispatch::jit);
+    else if (name == "batch")
+        sw->setAntDispatch(AntDispatch::batched);
+    else
+        return false;
+    return true;
+}
+
+void setStudentWorldSeed(GameWorld* gw, unsigned seed) { static_cast<StudentWorld*>(gw)->setSeed(seed); }
+
+void getStudentWorldResults(GameWorld* gw, int& winningColony, std::vector<int>& antCounts) {
+    auto sw = static_cast<StudentWorld*>(gw);
+    winningColony = sw->winningColony();
+    antCounts = sw->antCounts();
+}
+
+void setStudentWorldTickThreads(GameWorld* gw, unsigned threads) {
+    static_cast<StudentWorld*>(gw)->setTickThreads(threads);
+}
+
+void setStudentWorldProgramCacheFiles(bool enabled) { ProgramCache::instance().setCacheFiles(enabled); }
+
+double benchmarkStudentWorldAntDispatch(GameWorld* gw, int rounds, std::uint64_t& instructions) {
+    return static_cast<StudentWorld*>(gw)->benchmarkAntDispatch(rounds, instructions);
+}
+
 int StudentWorld::init() {
     StudentWorld::cleanUp();
+    // Actors draw random numbers as soon as they are created; see randInt.
+    ticks = 0;
 
     auto antFns = getFilenamesOfAntPrograms();
     if (antFns.size() > 4) antFns.resize(4);
     for (auto const& fn : antFns) {
-        Compiler c;
+        std::shared_ptr<Compiler const> c;
         std::string e;
-        if (c.compile(fn, e)) {
-            antInfo.emplace_back(c.getColonyName(), std::move(c));
+        std::unique_ptr<NativeLibrary> native;
+        if (NativeLibrary::isLibrary(fn)) {
+            // The compiler still gets the program, for anything that needs
+            // it besides running ants.
+            native.reset(new NativeLibrary);
+            auto loaded = std::make_shared<Compiler>();
+            if (native->open(fn, e) && loaded->load(native->program()->colonyName, native->program()->instructions,
+                                                    native->program()->size, e))
+                c = std::move(loaded);
+        } else {
+            c = ProgramCache::instance().get(fn, e);
+        }
+        if (c) {
+            antInfo.emplace_back(c->getColonyName(), std::move(c), std::move(native));
         } else {
             setError(fn + " " + e);
             return GWSTATUS_LEVEL_ERROR;
@@ -36,16 +100,16 @@ int StudentWorld::init() {
         for (int x = 0; x < VIEW_WIDTH; ++x) {
             for (int y = 0; y < VIEW_HEIGHT; ++y) {
                 auto insertAnthill = [this](Coord c, int t) {
-                    if (t < (int) antInfo.size()) insertActor<Anthill>(c, t, antInfo[t].compiler);
+                    if (t < (int) antInfo.size()) insertActor<Anthill>(c, t, *antInfo[t].compiler);
                 };
                 auto c = std::make_tuple(x, y);
                 switch (f.getContentsOf(x, y)) {
                 case Field::FieldItem::empty: break;
-                case Field::FieldItem::water: insertActor<PoolOfWater>(c); break;
-                case Field::FieldItem::poison: insertActor<Poison>(c); break;
-                case Field::FieldItem::rock: insertActor<Pebble>(c); break;
+                case Field::FieldItem::water: addTerrain(c, IID_WATER_POOL); break;
+                case Field::FieldItem::poison: addTerrain(c, IID_POISON); break;
+                case Field::FieldItem::rock: addTerrain(c, IID_ROCK); break;
                 case Field::FieldItem::grasshopper: insertActor<BabyGrasshopper>(c); break;
-                case Field::FieldItem::food: insertActor<Food>(c, 6000); break;
+                case Field::FieldItem::food: addFood(c, 6000); break;
                 case Field::FieldItem::anthill0: insertAnthill(c, 0); break;
                 case Field::FieldItem::anthill1: insertAnthill(c, 1); break;
                 case Field::FieldItem::anthill2: insertAnthill(c, 2); break;
@@ -55,48 +119,472 @@ int StudentWorld::init() {
         }
     }
 
-    ticks = 0;
     return GWSTATUS_CONTINUE_GAME;
 }
 
-int StudentWorld::move() {
-    ticks++;
+void StudentWorld::addTerrain(Coord c, int iid) {
+    scenery.emplace_back(iid, c);
+    occupancy[cellIndex(c)] |= maskOf(iid);
+    if (iid != IID_ROCK) {
+        assert(hazards.empty() || hazards.back() < scheduleKey(c, iid));
+        hazards.emplace_back(scheduleKey(c, iid));
+    }
+}
 
-    // Save a copy of all actors. It is unsafe to mutate a structure while
-    // iterating through it. So we first obtain all iterators (nodes) inside a
-    // map. This ensures that: (a) we only perform doSomething() on actors
-    // present at the beginning of the tick, not newly created ones; (b) the
-    // order of doSomething() is well-defined.
-    std::vector<ActorMap::iterator> allCurrentActors;
-    allCurrentActors.reserve(actors.size());
-    for (auto i = actors.begin(), ie = actors.end(); i != ie; ++i) allCurrentActors.emplace_back(i);
+void StudentWorld::applyHazard(int key) {
+    for (Actor* a : getActorsAt(cellCoord(key >> 4))) {
+        if ((key & 15) == IID_WATER_POOL)
+            a->beStunned();
+        else
+            a->bePoisoned();
+    }
+}
+
+int StudentWorld::consumeFood(Coord c, int maxAmount) {
+    int idx = cellIndex(c);
+    int consumed = std::min(maxAmount, food[idx]);
+    food[idx] -= consumed;
+    if (consumed && !food[idx]) (currentTile ? currentTile->exhaustedFood : exhaustedFood).emplace_back(idx);
+    return consumed;
+}
+
+void StudentWorld::addFood(Coord c, int amount) {
+    int idx = cellIndex(c);
+    food[idx] += amount;
+    if (!(occupancy[idx] & maskOf(IID_FOOD))) {
+        occupancy[idx] |= maskOf(IID_FOOD);
+        if (currentTile)
+            currentTile->newFood.emplace_back(idx);
+        else
+            foodSprites[idx] = pool<Sprite>().create(IID_FOOD, c);
+    }
+}
+
+void StudentWorld::removeExhaustedFood() {
+    for (int idx : exhaustedFood)
+        if (!food[idx] && (occupancy[idx] & maskOf(IID_FOOD))) {
+            occupancy[idx] &= ~maskOf(IID_FOOD);
+            releaseSprite(foodSprites[idx]);
+        }
+    exhaustedFood.clear();
+}
+
+void StudentWorld::addPheromone(Coord c, int type) {
+    int idx = cellIndex(c);
+    Scent& p = pheromones[idx][type];
+    if (int strength = pheromoneStrength(idx, type)) {
+        p.since = std::max(p.since, decayStepsAt(scheduleKey(idx, IID_PHEROMONE_TYPE0 + type)));
+        p.strength = std::max(768, strength + 256);
+        return;
+    }
+    // A new pheromone first decays in the tick after it is emitted.
+    p = {256, ticks};
+    Sprite*& sprite = pheromoneSprites[idx * MAX_ANT_COLONIES + type];
+    if (currentTile) {
+        if (!sprite) currentTile->newPheromones.emplace_back(idx * MAX_ANT_COLONIES + type);
+    } else if (!sprite) {
+        sprite = pool<Sprite>().create(IID_PHEROMONE_TYPE0 + type, c);
+        pheromoneExpiries.emplace(p.since + p.strength, idx * MAX_ANT_COLONIES + type);
+    }
+}
+
+void StudentWorld::reapPheromoneSprites() {
+    // Strengths only ever grow beyond what they were when an expiry was
+    // recorded, so an expiry that has come due either removes the sprite or
+    // is pushed back to the new expiry.
+    while (!pheromoneExpiries.empty() && pheromoneExpiries.top().first <= ticks) {
+        int i = pheromoneExpiries.top().second;
+        pheromoneExpiries.pop();
+        Scent const& p = pheromones[i / MAX_ANT_COLONIES][i % MAX_ANT_COLONIES];
+        if (pheromoneStrength(i / MAX_ANT_COLONIES, i % MAX_ANT_COLONIES))
+            pheromoneExpiries.emplace(p.since + p.strength, i);
+        else
+            releaseSprite(pheromoneSprites[i]);
+    }
+}
 
+void StudentWorld::releaseActor(Actor* a) {
+    switch (a->iid()) {
+    case IID_ANT_TYPE0:
+    case IID_ANT_TYPE1:
+    case IID_ANT_TYPE2:
+    case IID_ANT_TYPE3: return pool<Ant>().destroy(static_cast<Ant*>(a));
+    case IID_ANT_HILL: return pool<Anthill>().destroy(static_cast<Anthill*>(a));
+    case IID_BABY_GRASSHOPPER: return pool<BabyGrasshopper>().destroy(static_cast<BabyGrasshopper*>(a));
+    case IID_ADULT_GRASSHOPPER: return pool<AdultGrasshopper>().destroy(static_cast<AdultGrasshopper*>(a));
+    }
+    assert(false && "no pool for actor image ID");
+}
+
+void StudentWorld::writePoolStatistics(std::ostream& os) const {
+    auto write = [&os](char const* name, auto const& pool) {
+        os << name << ": " << pool.live() << " live, " << pool.peak() << " peak, " << pool.capacity() << " capacity\n";
+    };
+    write("Anthill", std::get<ObjectPool<Anthill>>(pools));
+    write("Ant", std::get<ObjectPool<Ant>>(pools));
+    write("BabyGrasshopper", std::get<ObjectPool<BabyGrasshopper>>(pools));
+    write("AdultGrasshopper", std::get<ObjectPool<AdultGrasshopper>>(pools));
+    write("Sprite", std::get<ObjectPool<Sprite>>(pools));
+    os << "ActorTable: " << actors.live() - tombstones.size() << " live, " << tombstones.size() << " tombstones, "
+       << actors.size() << " slots, " << compactions << " compactions, " << reclaimedSlots << " slots reclaimed\n";
+    os << "Ant instructions: " << antInstructions << " executed with "
+       << (dispatch == AntDispatch::batched    ? "batch"
+           : dispatch == AntDispatch::jit      ? "jit"
+           : dispatch == AntDispatch::tabled   ? "table"
+           : dispatch == AntDispatch::threaded ? "threaded"
+                                               : "switch")
+       << " dispatch\n";
+    if (batchedGroups)
+        os << "Batched: " << batchedInstructions << " ant instructions in " << batchedGroups << " groups\n";
+    if (workers) os << "Tiled tick: " << workers->size() << " threads\n";
+    // Indexed by Compiler::Condition; only conditions about the world are
+    // remembered, and so counted.
+    static char const* const conditionNames[] = {
+        "i_smell_danger_in_front_of_me", "i_smell_pheromone_in_front_of_me", "i_was_bit", "i_am_carrying_food",
+        "i_am_hungry", "i_am_standing_on_my_anthill", "i_am_standing_on_food", "i_am_standing_with_an_enemy",
+        "i_was_blocked_from_moving", "last_random_number_was_zero"};
+    static_assert(sizeof(conditionNames) / sizeof(*conditionNames) == std::tuple_size<decltype(conditionsSensed)>(),
+                  "condition names out of sync with Compiler::Condition");
+    for (std::size_t c = 0; c < conditionsSensed.size(); ++c)
+        if (conditionsSensed[c])
+            os << "Condition " << conditionNames[c] << ": sensed " << conditionsSensed[c] << " times, "
+               << conditionsRemembered[c] << " remembered ("
+               << 100.0 * conditionsRemembered[c] / conditionsSensed[c] << "% hit rate)\n";
+    os << "Random seed: " << seed << '\n';
+    ProgramCache::Statistics cache = ProgramCache::instance().statistics();
+    os << "Program cache: " << cache.programs << " programs, " << cache.hits << " hits, " << cache.compiled
+       << " compiled, " << cache.loaded << " loaded from cache files\n";
+}
+
+JitProgram const* StudentWorld::antJit(int type) {
+    AntColonyInfo& info = antInfo[type];
+    if (!info.jit) info.jit.reset(new JitProgram(info.compiler->getInstructions(), Ant::machineCodeCallbacks));
+    return info.jit->valid() ? info.jit.get() : nullptr;
+}
+
+void StudentWorld::prepareBatchedBursts() {
+    batchedExecuted.assign(actors.size(), -1);
+    batchedPc.resize(actors.size());
+    for (int t = 0; t < (int) antInfo.size(); ++t) {
+        if (antNative(t)) continue;
+        // Ants that sleep through this tick are left out.
+        auto& order = batchLanes.order;
+        order.clear();
+        for (ActorTable::Handle h : schedule)
+            if (actors.resolve(h) && actors.iid[h.slot] == IID_ANT_TYPE0 + t && !actors.sleep[h.slot])
+                order.emplace_back(actors.ic[h.slot], h.slot);
+        std::sort(order.begin(), order.end());
+        std::size_t n = order.size();
+        batchLanes.slot.resize(n);
+        batchLanes.rand.resize(n);
+        batchLanes.foodHeld.resize(n);
+        batchLanes.flags.resize(n);
+        batchLanes.taken.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            ActorTable::Slot s = order[i].second;
+            batchLanes.slot[i] = s;
+            batchLanes.rand[i] = actors.rand[s];
+            batchLanes.foodHeld[i] = actors.foodHeld[s];
+            batchLanes.flags[i] = actors.flags[s];
+        }
+        for (std::size_t b = 0, e; b < n; b = e) {
+            for (e = b + 1; e < n && order[e].first == order[b].first; ++e) {}
+            runBatch(*antInfo[t].compiler, b, e);
+        }
+    }
+}
+
+void StudentWorld::runBatch(Compiler const& program, std::size_t begin, std::size_t end) {
+    // Only conditions that nothing but the ant itself changes are batched, as
+    // every other one may change before the ant's turn comes. So a group stops
+    // at any other condition, at an action, and at generateRandomNumber, whose
+    // draws must come in the order of the schedule.
+    auto const& plain = program.getInstructions();
+    BatchLanes& lanes = batchLanes;
+    batchGroups.clear();
+    batchGroups.push_back({lanes.order[begin].first, 0, begin, end});
+    while (!batchGroups.empty()) {
+        BatchGroup g = batchGroups.back();
+        batchGroups.pop_back();
+        for (; g.executed < 10 && g.pc < plain.size(); ++g.executed) {
+            Compiler::Instruction const& instr = plain[g.pc];
+            if (instr.opcode == Compiler::Opcode::goto_command) {
+                g.pc = instr.operand;
+                continue;
+            }
+            if (instr.opcode != Compiler::Opcode::if_command) break;
+            std::uint8_t* taken = lanes.taken.data();
+            std::size_t b = g.begin, e = g.end;
+            switch (instr.condition) {
+            case Compiler::Condition::last_random_number_was_zero:
+                for (std::size_t i = b; i < e; ++i) taken[i] = lanes.rand[i] == 0;
+                break;
+            case Compiler::Condition::i_am_carrying_food:
+                for (std::size_t i = b; i < e; ++i) taken[i] = lanes.foodHeld[i] > 0;
+                break;
+            case Compiler::Condition::i_was_blocked_from_moving:
+                for (std::size_t i = b; i < e; ++i) taken[i] = (lanes.flags[i] & ActorTable::blocked) != 0;
+                break;
+            default: goto stop;
+            }
+            // Move the lanes that take the branch to the front of the group.
+            while (b < e) {
+                if (taken[b]) {
+                    ++b;
+                    continue;
+                }
+                --e;
+                std::swap(taken[b], taken[e]);
+                std::swap(lanes.slot[b], lanes.slot[e]);
+                std::swap(lanes.rand[b], lanes.rand[e]);
+                std::swap(lanes.foodHeld[b], lanes.foodHeld[e]);
+                std::swap(lanes.flags[b], lanes.flags[e]);
+            }
+            if (b == g.end) {
+                g.pc = instr.operand;
+            } else {
+                if (b != g.begin)
+                    batchGroups.push_back({static_cast<std::uint32_t>(instr.operand), g.executed + 1, g.begin, b});
+                g.begin = b;
+                ++g.pc;
+            }
+        }
+    stop:
+        ++batchedGroups;
+        for (std::size_t i = g.begin; i < g.end; ++i) {
+            batchedPc[lanes.slot[i]] = g.pc;
+            batchedExecuted[lanes.slot[i]] = static_cast<std::int8_t>(g.executed);
+        }
+    }
+}
+
+void StudentWorld::buildSchedule() {
+    // Every actor in the table that is not a tombstone is keyed by its
+    // schedule key in the upper and its arrival in the lower 32 bits, and the
+    // keys are put in order by a least significant digit first radix sort. The
+    // buffers keep their storage from tick to tick, so this only allocates
+    // when the population reaches a new peak.
+    scheduleEntries.clear();
+    for (ActorTable::Slot s = 0; s < actors.size(); ++s)
+        if (actors.owner[s] && !(actors.flags[s] & ActorTable::buried)) {
+            int key = scheduleKey(std::make_tuple(actors.x[s], actors.y[s]), actors.iid[s]);
+            scheduleEntries.push_back({static_cast<std::uint64_t>(key) << 32 | actors.arrival[s], s});
+        }
+    scheduleScratch.resize(scheduleEntries.size());
+    for (int shift = 0; shift < 48; shift += 8) {
+        std::array<std::size_t, 257> offsets{};
+        for (ScheduleEntry const& e : scheduleEntries) ++offsets[(e.key >> shift & 0xff) + 1];
+        // Skip the pass if every key has the same digit.
+        if (std::find(offsets.cbegin(), offsets.cend(), scheduleEntries.size()) != offsets.cend()) continue;
+        std::partial_sum(offsets.cbegin(), offsets.cend(), offsets.begin());
+        for (ScheduleEntry const& e : scheduleEntries) scheduleScratch[offsets[e.key >> shift & 0xff]++] = e;
+        scheduleEntries.swap(scheduleScratch);
+    }
+
+    schedule.clear();
+    for (ScheduleEntry const& e : scheduleEntries) schedule.emplace_back(actors.handle(e.slot));
+}
+
+double StudentWorld::benchmarkAntDispatch(int rounds, std::uint64_t& instructions) {
+    // Bursts are run outside of move(), so ants that move are not relinked and
+    // the world drifts out of sync with the table; restoring the table
+    // afterwards puts every actor back where the grid expects it.
+    ActorTable saved(actors);
+    instructions = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        if (dispatch == AntDispatch::batched) prepareBatchedBursts();
+        for (ActorTable::Slot s = 0; s < actors.size(); ++s)
+            if (actors.owner[s] && !(actors.flags[s] & ActorTable::buried) && actors.iid[s] >= IID_ANT_TYPE0 &&
+                actors.iid[s] <= IID_ANT_TYPE3 && !actors.owner[s]->isDead())
+                instructions += static_cast<Ant*>(actors.owner[s])->runBurst(dispatch);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    actors = saved;
+    return elapsed;
+}
+
+void StudentWorld::compactActors() {
+    ++compactions;
+    reclaimedSlots += tombstones.size();
+    for (Actor* a : tombstones) releaseActor(a);
+    tombstones.clear();
+
+    // Renumber the remaining rows in the order the schedule visits them, so
+    // that the next ticks walk the table front to back.
+    compactionOrder.clear();
+    for (ActorTable::Slot head : cells)
+        for (ActorTable::Slot s = head; s != ActorTable::none; s = actors.next[s]) compactionOrder.emplace_back(s);
+    actors.compact(compactionOrder);
+    for (ActorTable::Slot& head : cells) head = actors.remapped(head);
+    for (ActorTable::Slot s = 0; s < actors.size(); ++s) actors.owner[s]->m_slot = s;
+}
+
+void StudentWorld::link(ActorTable::Slot s) {
+    // Insert after all actors with the same or a smaller image ID, so that
+    // actors of the same image ID are kept in their order of arrival.
+    int idx = cellIndex(std::make_tuple(actors.x[s], actors.y[s]));
+    occupancy[idx] |= maskOf(actors.iid[s]);
+    actors.arrival[s] = currentTile ? currentTile->arrivals++ : arrivals++;
+    ActorTable::Slot* p = &cells[idx];
+    ActorTable::Slot prev = ActorTable::none;
+    while (*p != ActorTable::none && actors.iid[*p] <= actors.iid[s]) {
+        prev = *p;
+        p = &actors.next[*p];
+    }
+    actors.prev[s] = prev;
+    actors.next[s] = *p;
+    if (*p != ActorTable::none) actors.prev[*p] = s;
+    *p = s;
+}
+
+void StudentWorld::unlink(ActorTable::Slot s, Coord c) {
+    // Actors with the same image ID are adjacent, so s is the last one of its
+    // kind here if neither neighbour shares its image ID.
+    ActorTable::Slot prev = actors.prev[s], next = actors.next[s];
+    if (!(prev != ActorTable::none && actors.iid[prev] == actors.iid[s]) &&
+        !(next != ActorTable::none && actors.iid[next] == actors.iid[s]))
+        occupancy[cellIndex(c)] &= ~maskOf(actors.iid[s]);
+    if (prev != ActorTable::none)
+        actors.next[prev] = next;
+    else
+        cells[cellIndex(c)] = next;
+    if (next != ActorTable::none) actors.prev[next] = prev;
+    actors.prev[s] = actors.next[s] = ActorTable::none;
+}
+
+void StudentWorld::actInTurn(std::vector<ActorTable::Handle> const& turns, std::vector<int> const& hazardKeys,
+                             int& current) {
     // Ask actors to doSomething. Immediately after each actor does something,
     // we perform data structure maintenance to make sure the data structure is
     // in sync. This is necessary because actors in their doSomething() can look
-    // up other actors by their keys, and it is necessary therefore to do
+    // up other actors by their locations, and it is necessary therefore to do
     // maintenance after every single doSomething().
-    for (auto const& i : allCurrentActors) {
-        if (!i->second->isDead()) i->second->doSomething();
-        if (i->second->isDead()) {
-            actors.erase(i);
-        } else {
-            auto newKey = i->second->getKey();
-            if (newKey != i->first) {
-                auto p = std::move(i->second);
-                actors.erase(i);
-                actors.emplace(newKey, std::move(p));
-            }
+    auto hazard = hazardKeys.cbegin();
+    current = -1;
+    for (ActorTable::Handle h : turns) {
+        Actor* a = actors.resolve(h);
+        if (!a) continue;
+        auto oldCoord = a->getCoord();
+        int key = scheduleKey(oldCoord, a->iid());
+        current = schedulePosition(key);
+        for (; hazard != hazardKeys.cend() && *hazard < key; ++hazard) applyHazard(*hazard);
+        if (!a->isDead()) a->doSomething();
+        if (a->isDead()) {
+            buryActor(a, oldCoord);
+        } else if (a->getCoord() != oldCoord) {
+            unlink(h.slot, oldCoord);
+            // A tile may not touch cells beyond the next one while others of
+            // its color run.
+            if (currentTile && !withinReach(tileOf(cellIndex(oldCoord)), a->getCoord()))
+                currentTile->landings.emplace_back(h.slot);
+            else
+                link(h.slot);
         }
     }
+    for (; hazard != hazardKeys.cend(); ++hazard) applyHazard(*hazard);
+}
+
+void StudentWorld::moveTiles() {
+    for (TileWork& w : tiles) {
+        w.schedule.clear();
+        w.hazards.clear();
+    }
+    for (ActorTable::Handle h : schedule)
+        tiles[tileOf(cellIndex(std::make_tuple(actors.x[h.slot], actors.y[h.slot])))].schedule.emplace_back(h);
+    for (int key : hazards) tiles[tileOf(key >> 4)].hazards.emplace_back(key);
+    // Translated lazily otherwise, which must not happen on several threads.
+    if (dispatch == AntDispatch::jit)
+        for (int t = 0; t < (int) antInfo.size(); ++t) antJit(t);
+
+    std::function<void(std::size_t)> const actInTile = [this](std::size_t i) {
+        TileWork& w = tiles[colorTiles[i]];
+        currentTile = &w;
+        actInTurn(w.schedule, w.hazards, w.currentKey);
+        currentTile = nullptr;
+    };
+    for (int color = 0; color < 4; ++color) {
+        colorTiles.clear();
+        for (int t = 0; t < tileCount; ++t)
+            if (colorOf(t) == color && !(tiles[t].schedule.empty() && tiles[t].hazards.empty())) {
+                // Arrivals in a cell during a color all come from the same
+                // tile, so each tile can number them from the same point.
+                tiles[t].arrivals = arrivals;
+                colorTiles.emplace_back(t);
+            }
+        workers->run(colorTiles.size(), actInTile);
+        for (int t : colorTiles) arrivals = std::max(arrivals, tiles[t].arrivals);
+        for (int t : colorTiles) finishTile(tiles[t]);
+    }
+}
+
+void StudentWorld::finishTile(TileWork& w) {
+    for (ActorTable::Slot s : w.landings) link(s);
+    for (Birth const& b : w.births) {
+        if (b.iid == IID_ADULT_GRASSHOPPER)
+            insertActor<AdultGrasshopper>(b.c);
+        else
+            insertActor<Ant>(b.c, b.colony, *b.program);
+    }
+    for (int t : w.antsBorn) increaseAntCountForColony(t);
+    for (int idx : w.newFood)
+        if (!foodSprites[idx]) foodSprites[idx] = pool<Sprite>().create(IID_FOOD, cellCoord(idx));
+    for (int i : w.newPheromones) {
+        Sprite*& sprite = pheromoneSprites[i];
+        if (sprite) continue;
+        sprite = pool<Sprite>().create(IID_PHEROMONE_TYPE0 + i % MAX_ANT_COLONIES, cellCoord(i / MAX_ANT_COLONIES));
+        Scent const& p = pheromones[i / MAX_ANT_COLONIES][i % MAX_ANT_COLONIES];
+        pheromoneExpiries.emplace(p.since + p.strength, i);
+    }
+    exhaustedFood.insert(exhaustedFood.end(), w.exhaustedFood.cbegin(), w.exhaustedFood.cend());
+    tombstones.insert(tombstones.end(), w.tombstones.cbegin(), w.tombstones.cend());
+    antInstructions += w.antInstructions;
+    batchedInstructions += w.batchedInstructions;
+    for (std::size_t c = 0; c < conditionsSensed.size(); ++c) {
+        conditionsSensed[c] += w.conditionsSensed[c];
+        conditionsRemembered[c] += w.conditionsRemembered[c];
+    }
+    w.landings.clear();
+    w.births.clear();
+    w.antsBorn.clear();
+    w.newFood.clear();
+    w.newPheromones.clear();
+    w.exhaustedFood.clear();
+    w.tombstones.clear();
+    w.antInstructions = w.batchedInstructions = 0;
+    w.conditionsSensed.fill(0);
+    w.conditionsRemembered.fill(0);
+}
+
+int StudentWorld::move() {
+    ticks++;
+
+    // Save a copy of all actors. It is unsafe to mutate a structure while
+    // iterating through it. So we first obtain handles to all actors, sorted
+    // in the order described in report.txt. This ensures that: (a) we only
+    // perform doSomething() on actors present at the beginning of the tick, not
+    // newly created ones; (b) the order of doSomething() is well-defined.
+    buildSchedule();
+    std::fill(actors.draws.begin(), actors.draws.end(), 0);
+    if (dispatch == AntDispatch::batched) prepareBatchedBursts();
+
+    if (workers)
+        moveTiles();
+    else
+        actInTurn(schedule, hazards, currentKey);
+    currentKey = std::numeric_limits<int>::max();
+    removeExhaustedFood();
+    reapPheromoneSprites();
 
     // Final garbage collection pass. An earlier actor may have become dead
     // through the actions of a later actor.
-    for (auto i = actors.begin(); i != actors.end();)
-        if (i->second->isDead())
-            i = actors.erase(i);
-        else
-            ++i;
+    for (ActorTable::Slot head : cells)
+        for (ActorTable::Slot s = head, next; s != ActorTable::none; s = next) {
+            next = actors.next[s];
+            Actor* a = actors.owner[s];
+            if (a->isDead()) buryActor(a, a->getCoord());
+        }
+    if (!tombstones.empty() && tombstones.size() * 100 >= actors.live() * compactionThreshold) compactActors();
 
     setGameStatText(makeStatusText());
     if (ticks < 2000)
@@ -109,7 +597,29 @@ int StudentWorld::move() {
 }
 
 void StudentWorld::cleanUp() {
-    actors.clear();
+    for (ActorTable::Slot& head : cells)
+        while (head != ActorTable::none) destroyActor(actors.owner[head], actors.owner[head]->getCoord());
+    for (Actor* a : tombstones) releaseActor(a);
+    tombstones.clear();
+    schedule.clear();
+    arrivals = 0;
+    actorIds = 0;
+    hazards.clear();
+    scenery.clear();
+    food.fill(0);
+    for (Sprite*& sprite : foodSprites) releaseSprite(sprite);
+    exhaustedFood.clear();
+    for (auto& cell : pheromones) cell.fill({0, 0});
+    for (Sprite*& sprite : pheromoneSprites) releaseSprite(sprite);
+    pheromoneExpiries = {};
+    currentKey = 0;
+    occupancy.fill(0);
+    actors.reset();
     antInfo.clear();
     currentWinningAnt = -1;
+    antInstructions = 0;
+    conditionsSensed.fill(0);
+    conditionsRemembered.fill(0);
+    batchedExecuted.clear();
+    batchedInstructions = batchedGroups = 0;
 }
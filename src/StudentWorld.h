@@ -1,15 +1,28 @@
 #ifndef STUDENTWORLD_H_
 #define STUDENTWORLD_H_
 
+#include "Actor.h"
+#include "ActorTable.h"
 #include "Compiler.h"
 #include "Field.h"
 #include "GameWorld.h"
+#include "JitProgram.h"
+#include "NativeProgram.h"
+#include "ObjectPool.h"
+#include "ProgramCache.h"
+#include "RandomStream.h"
+#include "WorkerPool.h"
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <iomanip>
-#include <map>
+#include <iterator>
 #include <memory>
+#include <queue>
 #include <sstream>
 #include <string>
 #include <tuple>
@@ -20,43 +33,237 @@
 #error "This file requires C++14."
 #endif
 
-typedef std::tuple<int, int> Coord;
-class Actor;
+class StudentWorld final : public GameWorld {
+public:
+    // A set of image IDs, one bit per image ID.
+    typedef std::uint16_t IIDMask;
+    static constexpr IIDMask maskOf(int iid) { return static_cast<IIDMask>(1u << iid); }
+    static_assert(IID_PHEROMONE_TYPE3 < 16, "IIDMask is too narrow for all image IDs");
 
-template<std::size_t N>
-struct TupleComp {
-    template<typename T, std::size_t... I>
-    static auto select_from_tuple(T const& t, std::index_sequence<I...>) {
-        return std::make_tuple(std::get<I>(t)...);
+private:
+    // The mutable state of every live actor; see ActorTable.h. Declared before
+    // the pools so that it outlives the actors they hold.
+    ActorTable actors;
+    // All actors and sprites created during a simulation come from these
+    // pools, so that steady-state ticks do not touch the general heap.
+    std::tuple<ObjectPool<Anthill>, ObjectPool<Ant>, ObjectPool<BabyGrasshopper>, ObjectPool<AdultGrasshopper>,
+               ObjectPool<Sprite>>
+      pools;
+    template<typename T>
+    ObjectPool<T>& pool() {
+        return std::get<ObjectPool<T>>(pools);
     }
-    template<typename... T, typename... U>
-    bool operator()(std::tuple<T...> const& a, std::tuple<U...> const& b) const {
-        static_assert(sizeof...(T) == N || sizeof...(U) == N, "at least one tuple shall be full size");
-        static_assert(sizeof...(T) <= N && sizeof...(U) <= N, "both tuples shall be no longer than full size");
-        auto seq = std::make_index_sequence<std::min(sizeof...(T), sizeof...(U))>();
-        return select_from_tuple(a, seq) < select_from_tuple(b, seq);
+    void releaseActor(Actor* a);
+    void releaseSprite(Sprite*& s) {
+        if (s) pool<Sprite>().destroy(s);
+        s = nullptr;
     }
-    typedef bool is_transparent;
-};
 
-class StudentWorld final : public GameWorld {
-private:
-    typedef std::tuple<int, int, int> ActorKey;
-    typedef std::multimap<ActorKey, std::unique_ptr<Actor>, TupleComp<std::tuple_size<ActorKey>::value>> ActorMap;
-    typedef std::pair<ActorMap::const_iterator, ActorMap::const_iterator> RawActorRange;
-
-    ActorMap actors;
+    // Each cell holds the slot of the head of a doubly-linked list of the
+    // actors located there, threaded through the prev and next columns of the
+    // ActorTable and sorted by image ID and then by order of arrival. Cells are
+    // laid out so that a linear scan visits them in increasing (x, y) order.
+    std::array<ActorTable::Slot, VIEW_WIDTH * VIEW_HEIGHT> cells;
+    // The image IDs of the actors in each cell, kept in sync with cells. The
+    // bits for pebbles, pools of water and poison form the terrain plane: they
+    // are set once by init() and never change afterwards.
+    std::array<IIDMask, VIEW_WIDTH * VIEW_HEIGHT> occupancy;
+    // Handles to the actors present at the beginning of the tick, in order.
+    std::vector<ActorTable::Handle> schedule;
+    // Each link() stamps the actor with the next arrival sequence number, so
+    // that (schedule key, arrival) orders actors the way the cell lists do.
+    std::uint32_t arrivals;
+    struct ScheduleEntry {
+        std::uint64_t key;
+        ActorTable::Slot slot;
+    };
+    std::vector<ScheduleEntry> scheduleEntries, scheduleScratch;
+    void buildSchedule();
     int ticks;
 
+    // Every actor draws its random numbers from a RandomStream of its own,
+    // keyed by the seed of the match, its id and the tick, so that a match
+    // played again with the same seed goes exactly the same way, even if its
+    // actors were to act in some other order.
+    unsigned seed;
+    std::uint32_t actorIds;
+
+    // Pools of water and poison still act once per tick, at the point in the
+    // schedule where an actor with their location and image ID would. Their
+    // schedule keys are kept sorted so that move() can merge them in.
+    std::vector<int> hazards;
+    std::deque<Sprite> scenery;
+
+    // Food is kept as an amount per cell. As with the Food actors it replaces,
+    // a pile of food that runs out is still there (and occupancy says so) until
+    // the end of the tick, so exhaustedFood remembers where to look.
+    std::array<int, VIEW_WIDTH * VIEW_HEIGHT> food;
+    std::array<Sprite*, VIEW_WIDTH * VIEW_HEIGHT> foodSprites;
+    std::vector<int> exhaustedFood;
+    void removeExhaustedFood();
+
+    // Pheromones are kept per cell and per colony as the strength they had
+    // after a given number of decay steps. A pheromone decays by one at the
+    // point in each tick where an actor with its location and image ID would
+    // act, so its current strength follows from the number of such points
+    // passed since then. Each live pheromone also has a sprite, which is
+    // removed at the end of the tick its pheromone runs out.
+    struct Scent {
+        int strength;
+        int since;
+    };
+    std::array<std::array<Scent, MAX_ANT_COLONIES>, VIEW_WIDTH * VIEW_HEIGHT> pheromones;
+    std::array<Sprite*, VIEW_WIDTH * VIEW_HEIGHT * MAX_ANT_COLONIES> pheromoneSprites;
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>>
+      pheromoneExpiries;
+    // The schedule position (see schedulePosition) of the actor currently
+    // doing something.
+    int currentKey;
+
+    int decayStepsAt(int key) const {
+        return ticks - ((currentTile ? currentTile->currentKey : currentKey) < schedulePosition(key));
+    }
+    int pheromoneStrength(int idx, int type) const {
+        Scent const& p = pheromones[idx][type];
+        int decayed = decayStepsAt(scheduleKey(idx, IID_PHEROMONE_TYPE0 + type)) - p.since;
+        return std::max(0, p.strength - std::max(0, decayed));
+    }
+    void reapPheromoneSprites();
+
+    static int cellIndex(Coord c) {
+        assert(0 <= std::get<0>(c) && std::get<0>(c) < VIEW_WIDTH);
+        assert(0 <= std::get<1>(c) && std::get<1>(c) < VIEW_HEIGHT);
+        return std::get<0>(c) * VIEW_HEIGHT + std::get<1>(c);
+    }
+    static Coord cellCoord(int idx) { return std::make_tuple(idx / VIEW_HEIGHT, idx % VIEW_HEIGHT); }
+    static int scheduleKey(int idx, int iid) { return idx << 4 | iid; }
+    static_assert(VIEW_WIDTH * VIEW_HEIGHT <= 1 << 12, "schedule keys must fit in 16 bits");
+    static int scheduleKey(Coord c, int iid) { return scheduleKey(cellIndex(c), iid); }
+    void addTerrain(Coord c, int iid);
+    void applyHazard(int key);
+    void link(ActorTable::Slot s);
+    void unlink(ActorTable::Slot s, Coord c);
+    void destroyActor(Actor* a, Coord c) {
+        unlink(a->m_slot, c);
+        releaseActor(a);
+    }
+
+    // Dead actors are unlinked from their cell, hidden and their handles
+    // invalidated right away, which hides them from all queries, but their objects and
+    // table rows are only released in bulk by compactActors(), once they make
+    // up compactionThreshold percent of the table.
+    static constexpr int compactionThreshold = 25;
+    std::vector<Actor*> tombstones;
+    std::vector<ActorTable::Slot> compactionOrder;
+    std::size_t compactions, reclaimedSlots;
+    void buryActor(Actor* a, Coord c) {
+        unlink(a->m_slot, c);
+        actors.invalidate(a->m_slot);
+        actors.flags[a->m_slot] |= ActorTable::buried;
+        a->setVisible(false);
+        (currentTile ? currentTile->tombstones : tombstones).emplace_back(a);
+    }
+    void compactActors();
+
+    // With a tiled tick, the grid is cut into tiles of tileSize by tileSize
+    // cells, colored by whether their column and row are even or odd. The tick
+    // goes through the four colors in turn and lets the actors of all tiles of
+    // a color act at the same time, each tile on a thread of workers; see
+    // report.txt for how this differs from the sequential tick. Except for a
+    // jumping adult grasshopper, an actor only touches its own cell and the
+    // next one, so two tiles of the same color never touch the same cell. What
+    // else an actor changes is collected in the TileWork of its tile and put
+    // into effect, in the order of the tiles, once all tiles of the color are
+    // done, so that the outcome does not depend on the number of threads.
+    static constexpr int tileSize = 8;
+    static constexpr int tileRows = (VIEW_HEIGHT + tileSize - 1) / tileSize;
+    static constexpr int tileCount = (VIEW_WIDTH + tileSize - 1) / tileSize * tileRows;
+    static int tileOf(int idx) { return idx / VIEW_HEIGHT / tileSize * tileRows + idx % VIEW_HEIGHT / tileSize; }
+    static int colorOf(int tile) { return tile / tileRows % 2 * 2 + tile % tileRows % 2; }
+    // Orders actors and hazards the way the tick visits them: by schedule key,
+    // and with a tiled tick by the color of their tile first.
+    int schedulePosition(int key) const { return workers ? colorOf(tileOf(key >> 4)) << 16 | key : key; }
+    struct Birth {
+        int iid;
+        Coord c;
+        int colony;
+        Compiler const* program;
+    };
+    struct TileWork {
+        std::vector<ActorTable::Handle> schedule;
+        std::vector<int> hazards;
+        int currentKey;
+        std::uint32_t arrivals;
+        std::vector<ActorTable::Slot> landings; // Jumped beyond the next cell; linked at the end of the color.
+        std::vector<Birth> births;
+        std::vector<int> antsBorn; // Colonies, for increaseAntCountForColony.
+        std::vector<int> newFood, newPheromones; // Cells, and cells times colonies plus colony, needing sprites.
+        std::vector<int> exhaustedFood;
+        std::vector<Actor*> tombstones;
+        std::uint64_t antInstructions, batchedInstructions;
+        std::array<std::uint64_t, Compiler::Condition::last_random_number_was_zero + 1> conditionsSensed,
+          conditionsRemembered;
+    };
+    std::vector<TileWork> tiles;
+    std::vector<int> colorTiles;
+    // Null for a sequential tick.
+    std::unique_ptr<WorkerPool> workers;
+    // The tile whose actors the calling thread is running, if any.
+    static thread_local TileWork* currentTile;
+    void actInTurn(std::vector<ActorTable::Handle> const& turns, std::vector<int> const& hazardKeys, int& current);
+    void moveTiles();
+    void finishTile(TileWork& w);
+    bool withinReach(int tile, Coord c) const {
+        int x = std::get<0>(c), y = std::get<1>(c);
+        int x0 = tile / tileRows * tileSize, y0 = tile % tileRows * tileSize;
+        return x0 - 1 <= x && x <= x0 + tileSize && y0 - 1 <= y && y <= y0 + tileSize;
+    }
+
     struct AntColonyInfo {
         std::string name;
-        Compiler compiler;
+        std::shared_ptr<Compiler const> compiler; // Shared with other worlds; see ProgramCache.
         int antCount;
-        AntColonyInfo(std::string const& name, Compiler&& compiler)
-          : name(name), compiler(std::move(compiler)), antCount(0) {}
+        std::unique_ptr<JitProgram> jit; // Translated on first use; see antJit().
+        std::unique_ptr<NativeLibrary> native; // Set if loaded from a shared object built by bug2cpp.
+        AntColonyInfo(std::string const& name, std::shared_ptr<Compiler const> compiler,
+                      std::unique_ptr<NativeLibrary> native)
+          : name(name), compiler(std::move(compiler)), antCount(0), jit{}, native(std::move(native)) {}
     };
     std::vector<AntColonyInfo> antInfo;
     int currentWinningAnt;
+    AntDispatch dispatch;
+    std::uint64_t antInstructions;
+    // Per Condition, how often ants sensed it, and how many of those times
+    // they remembered it from earlier in the same burst.
+    std::array<std::uint64_t, Compiler::Condition::last_random_number_was_zero + 1> conditionsSensed,
+      conditionsRemembered;
+
+    // With batch dispatch, each tick starts with prepareBatchedBursts running
+    // the first instructions of the bursts of all ants at once; see report.txt.
+    // The ants of a colony are lanes, grouped by instruction counter, and each
+    // group executes one instruction at a time for all of its lanes, splitting
+    // in two at a branch that some of its lanes take. The lanes keep copies of
+    // the columns the batched conditions need, so that evaluating a condition
+    // for a whole group is a loop over contiguous arrays.
+    struct BatchLanes {
+        std::vector<std::pair<std::uint32_t, ActorTable::Slot>> order;
+        std::vector<ActorTable::Slot> slot;
+        std::vector<std::int32_t> rand, foodHeld;
+        std::vector<std::uint8_t> flags, taken;
+    } batchLanes;
+    struct BatchGroup {
+        std::uint32_t pc;
+        int executed;
+        std::size_t begin, end;
+    };
+    std::vector<BatchGroup> batchGroups;
+    // Per slot, where prepareBatchedBursts left the ant and how many
+    // instructions it executed on the way, or -1 if it did not run the ant.
+    std::vector<std::uint32_t> batchedPc;
+    std::vector<std::int8_t> batchedExecuted;
+    std::uint64_t batchedInstructions, batchedGroups;
+    void prepareBatchedBursts();
+    void runBatch(Compiler const& program, std::size_t begin, std::size_t end);
 
     std::string makeStatusText() const {
         std::ostringstream oss;
@@ -71,29 +278,145 @@ private:
     }
 
 public:
-    StudentWorld(std::string assetDir) : GameWorld(assetDir), actors{}, ticks(0), antInfo{}, currentWinningAnt{-1} {}
+    StudentWorld(std::string assetDir)
+      : GameWorld(assetDir), actors{}, pools{}, cells(), occupancy{}, schedule{}, arrivals(0), scheduleEntries{},
+        scheduleScratch{}, ticks(0), seed(randomSeed()), actorIds(0), hazards{}, scenery{}, food{}, foodSprites{},
+        exhaustedFood{}, pheromones{}, pheromoneSprites{}, pheromoneExpiries{}, currentKey(0), tombstones{},
+        compactionOrder{}, compactions(0), reclaimedSlots(0), tiles(tileCount), colorTiles{}, workers{}, antInfo{},
+        currentWinningAnt{-1}, dispatch(BUGS_THREADED_DISPATCH ? AntDispatch::threaded : AntDispatch::switched),
+        antInstructions(0), conditionsSensed{}, conditionsRemembered{}, batchLanes{}, batchGroups{}, batchedPc{},
+        batchedExecuted{}, batchedInstructions(0), batchedGroups(0) {
+        cells.fill(ActorTable::none);
+    }
+    virtual ~StudentWorld() { StudentWorld::cleanUp(); }
     virtual int init() override;
     virtual int move() override;
     virtual void cleanUp() override;
 
-    struct ActorRange : private RawActorRange {
+    ActorTable& table() { return actors; }
+    // Sets the seed of the matches init() starts from now on. It defaults to
+    // the one returned by randomSeed().
+    void setSeed(unsigned s) { seed = s; }
+    unsigned getSeed() const { return seed; }
+    // The colony winning the match so far, or -1 if there is none, and the
+    // number of ants each colony has produced.
+    int winningColony() const { return currentWinningAnt; }
+    std::vector<int> antCounts() const {
+        std::vector<int> counts;
+        for (AntColonyInfo const& info : antInfo) counts.emplace_back(info.antCount);
+        return counts;
+    }
+    std::uint32_t newActorId() { return actorIds++; }
+    // Draws the next random number of the actor in the given slot.
+    int randInt(ActorTable::Slot s, int min, int max) {
+        if (max < min) std::swap(max, min);
+        RandomStream stream(seed, actors.id[s], static_cast<std::uint32_t>(ticks), actors.draws[s],
+                            actors.randoms[s]);
+        return min + static_cast<int>(boundedRandom(stream, static_cast<std::uint32_t>(max - min) + 1));
+    }
+    AntDispatch antDispatch() const { return dispatch; }
+    void setAntDispatch(AntDispatch d) { dispatch = d; }
+    void countAntInstructions(int n) { (currentTile ? currentTile->antInstructions : antInstructions) += n; }
+    void countSensedCondition(Compiler::Condition c, bool remembered) {
+        ++(currentTile ? currentTile->conditionsSensed : conditionsSensed)[c];
+        (currentTile ? currentTile->conditionsRemembered : conditionsRemembered)[c] += remembered;
+    }
+    // Switches to a tiled tick run by the given number of threads, or back to
+    // the sequential tick if it is 0.
+    void setTickThreads(unsigned threads) { workers.reset(threads ? new WorkerPool(threads) : nullptr); }
+    // Returns whether prepareBatchedBursts started the burst of the ant in the
+    // given slot this tick, and if so where to continue it from.
+    bool takeBatchedBurst(ActorTable::Slot s, std::uint32_t& pc, int& executed) {
+        if (s >= batchedExecuted.size() || batchedExecuted[s] < 0) return false;
+        pc = batchedPc[s];
+        executed = batchedExecuted[s];
+        batchedExecuted[s] = -1;
+        (currentTile ? currentTile->batchedInstructions : batchedInstructions) += executed;
+        return true;
+    }
+    // Returns the program of the given colony translated to machine code, or
+    // nullptr if it cannot be.
+    JitProgram const* antJit(int type);
+    // Returns the native code of the given colony if it was loaded from a
+    // shared object, or nullptr.
+    NativeProgram const* antNative(int type) const {
+        auto const& native = antInfo[type].native;
+        return native ? native->program() : nullptr;
+    }
+    // Runs every live ant for the given number of bursts with the current
+    // dispatch, then restores the actor table. Returns the time taken in
+    // seconds and sets instructions to the number of instructions executed.
+    double benchmarkAntDispatch(int rounds, std::uint64_t& instructions);
+
+    class ActorIterator {
+    private:
+        ActorTable const* m_table;
+        ActorTable::Slot m_slot;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Actor* value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Actor* const* pointer;
+        typedef Actor* const& reference;
+        ActorIterator(ActorTable const& t, ActorTable::Slot s) : m_table(&t), m_slot(s) {}
+        Actor* operator*() const { return m_table->owner[m_slot]; }
+        ActorIterator& operator++() {
+            m_slot = m_table->next[m_slot];
+            return *this;
+        }
+        bool operator==(ActorIterator const& o) const { return m_slot == o.m_slot; }
+        bool operator!=(ActorIterator const& o) const { return m_slot != o.m_slot; }
+    };
+    struct ActorRange : private std::pair<ActorIterator, ActorIterator> {
         auto begin() const { return first; }
         auto end() const { return second; }
         bool empty() const { return first == second; }
-        ActorRange(RawActorRange const& p) : RawActorRange(p) {}
+        ActorRange(ActorTable const& t, ActorTable::Slot b, ActorTable::Slot e)
+          : std::pair<ActorIterator, ActorIterator>(ActorIterator(t, b), ActorIterator(t, e)) {}
     };
-    template<typename K, typename... T>
-    ActorRange getActorsAt(K k, T... t) const {
-        return actors.equal_range(std::tuple_cat(k, std::make_tuple(t...)));
+    bool anyActorsAt(Coord c, IIDMask mask) const { return occupancy[cellIndex(c)] & mask; }
+    int consumeFood(Coord c, int maxAmount);
+    void addFood(Coord c, int amount);
+    bool anyPheromoneAt(Coord c) const {
+        for (int t = 0; t < MAX_ANT_COLONIES; ++t)
+            if (pheromoneStrength(cellIndex(c), t)) return true;
+        return false;
+    }
+    void addPheromone(Coord c, int type);
+    ActorRange getActorsAt(Coord c) const { return {actors, cells[cellIndex(c)], ActorTable::none}; }
+    ActorRange getActorsAt(Coord c, int iid) const {
+        ActorTable::Slot b = cells[cellIndex(c)];
+        while (b != ActorTable::none && actors.iid[b] < iid) b = actors.next[b];
+        ActorTable::Slot e = b;
+        while (e != ActorTable::none && actors.iid[e] == iid) e = actors.next[e];
+        return {actors, b, e};
     }
 
+    // Actors born during a tiled tick are only created at the end of the color
+    // of their tile.
     template<typename Actor, typename... Args>
     void insertActor(Args&&... args) {
-        auto p = std::make_unique<Actor>(*this, std::forward<Args>(args)...);
-        actors.emplace(p->getKey(), std::move(p));
+        if (currentTile) return deferBirth(static_cast<Actor*>(nullptr), std::forward<Args>(args)...);
+        link(pool<Actor>().create(*this, std::forward<Args>(args)...)->m_slot);
     }
+    void deferBirth(Ant*, Coord c, int colony, Compiler const& program) {
+        currentTile->births.push_back({IID_ANT_TYPE0 + colony, c, colony, &program});
+    }
+    void deferBirth(AdultGrasshopper*, Coord c) {
+        currentTile->births.push_back({IID_ADULT_GRASSHOPPER, c, 0, nullptr});
+    }
+    template<typename Actor, typename... Args>
+    void deferBirth(Actor*, Args&&...) {
+        assert(false && "only ants and adult grasshoppers are born during a tick");
+    }
+
+    // Writes the live, peak and total number of objects in each pool, how the
+    // actor table has been compacted and how many ant instructions have run.
+    void writePoolStatistics(std::ostream& os) const;
 
     void increaseAntCountForColony(int t) {
+        if (currentTile) return currentTile->antsBorn.push_back(t);
         // The winner is defined as one that produced more ants than its
         // competitors, or if there is a tie, the colony that produced the most
         // ants first.
@@ -0,0 +1,89 @@
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that work through jobs together. run() hands out the
+// indices of a job one at a time to whichever thread asks next, the calling
+// thread included, and returns once all of them are done. The threads wait
+// for the next job in between, so they are only started once.
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads)
+      : m_mutex{}, m_wake{}, m_done{}, m_threads{}, m_job(nullptr), m_size(0), m_next(0), m_busy(0), m_jobs(0),
+        m_stopping(false) {
+        for (unsigned i = 1; i < threads; ++i) m_threads.emplace_back([this] { work(); });
+    }
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& t : m_threads) t.join();
+    }
+
+    // The number of threads, counting the one calling run().
+    unsigned size() const { return static_cast<unsigned>(m_threads.size()) + 1; }
+
+    // Calls job(i) for every i from 0 to n - 1.
+    void run(std::size_t n, std::function<void(std::size_t)> const& job) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = &job;
+            m_size = n;
+            m_next = 0;
+            m_busy = static_cast<unsigned>(m_threads.size());
+            ++m_jobs;
+        }
+        m_wake.notify_all();
+        take(job, n);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return !m_busy; });
+        m_job = nullptr;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_wake, m_done;
+    std::vector<std::thread> m_threads;
+    std::function<void(std::size_t)> const* m_job;
+    std::size_t m_size;
+    std::atomic<std::size_t> m_next;
+    unsigned m_busy;
+    std::uint64_t m_jobs; // Counts the jobs started, so that a thread does not take one twice.
+    bool m_stopping;
+
+    void take(std::function<void(std::size_t)> const& job, std::size_t n) {
+        for (std::size_t i; (i = m_next++) < n;) job(i);
+    }
+    void work() {
+        std::uint64_t seen = 0;
+        for (;;) {
+            std::function<void(std::size_t)> const* job;
+            std::size_t n;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_stopping || m_jobs != seen; });
+                if (m_stopping) return;
+                seen = m_jobs;
+                job = m_job;
+                n = m_size;
+            }
+            take(*job, n);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!--m_busy) m_done.notify_one();
+        }
+    }
+};
+
+#endif // WORKERPOOL_H_
@@ -1,7 +1,11 @@
 #include "GameController.h"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
 #include <string>
+#include <vector>
 using namespace std;
 
   // If your program is having trouble finding the Assets directory,
@@ -13,6 +17,7 @@ const string assetDirectory = "Assets";
 class GameWorld;
 
 GameWorld* createStudentWorld(string assetDir = "");
+void setStudentWorldSeed(GameWorld* gw, unsigned seed);
 
 int main(int argc, char* argv[])
 {
@@ -31,5 +36,27 @@ int main(int argc, char* argv[])
 	}
 
 	GameWorld* gw = createStudentWorld(assetDirectory);
-	Game().run(argc, argv, gw, "Bugs");
+
+	  // --seed=N replays the match played with seed N; every other argument
+	  // is passed on
+	vector<char*> args(argv, argv + argc);
+	for (auto it = args.begin() + 1; it != args.end(); )
+	{
+		if (strncmp(*it, "--seed=", 7) != 0)
+		{
+			++it;
+			continue;
+		}
+		char* end;
+		unsigned long seed = strtoul(*it + 7, &end, 10);
+		if (!(*it)[7]  ||  *end  ||  seed > numeric_limits<unsigned>::max())
+		{
+			cout << "Invalid seed: " << *it + 7 << endl;
+			return 1;
+		}
+		setStudentWorldSeed(gw, static_cast<unsigned>(seed));
+		it = args.erase(it);
+	}
+	args.push_back(nullptr);
+	Game().run(static_cast<int>(args.size()) - 1, args.data(), gw, "Bugs");
 }
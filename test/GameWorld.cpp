@@ -1,4 +1,5 @@
 #include "GameWorld.h"
+#include "GraphObject.h"
 #include <cstdlib>
 #include <string>
 using namespace std;
@@ -7,4 +8,6 @@ bool GameWorld::getKey(int& value) { return false; }
 
 void GameWorld::playSound(int soundID) {}
 
-void GameWorld::setGameStatText(string text) { printf("GameController setting status text: %s\n", text.c_str()); }
+void GameWorld::setGameStatText(string text) {
+    if (GraphObject::logging()) printf("GameController setting status text: %s\n", text.c_str());
+}
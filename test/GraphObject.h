@@ -8,20 +8,29 @@
 class GraphObject {
 public:
     enum Direction { none, up, right, down, left };
+    // Whether every call is logged to standard output, which it is unless
+    // turned off before any GraphObject is created.
+    static bool& logging() {
+        static bool enabled = true;
+        return enabled;
+    }
     GraphObject(int imageID, int startX, int startY, Direction dir = right, int depth = 0, double size = 0.25)
       : m_imageID(imageID), m_x(startX), m_y(startY), m_direction(dir) {
-        printf("GraphObject %p created with (imageID=%s, startX=%d, startY=%d, dir=%s, depth=%d, size=%.2f)\n", this,
-               describeIID(imageID), startX, startY, describeDirection(dir), depth, size);
+        if (logging())
+            printf("GraphObject %p created with (imageID=%s, startX=%d, startY=%d, dir=%s, depth=%d, size=%.2f)\n",
+                   this, describeIID(imageID), startX, startY, describeDirection(dir), depth, size);
     }
     virtual ~GraphObject() noexcept {
-        printf("GraphObject %p (imageID=%s, x=%d, y=%d, dir=%s) destructed\n", this, describeIID(m_imageID), m_x, m_y,
-               describeDirection(m_direction));
+        if (logging())
+            printf("GraphObject %p (imageID=%s, x=%d, y=%d, dir=%s) destructed\n", this, describeIID(m_imageID), m_x,
+                   m_y, describeDirection(m_direction));
     }
     int getX() const { return m_x; }
     int getY() const { return m_y; }
     void moveTo(int x, int y) {
-        printf("GraphObject %p (imageID=%s, x=%d, y=%d, dir=%s) moving to (x=%d, y=%d)\n", this, describeIID(m_imageID),
-               m_x, m_y, describeDirection(m_direction), x, y);
+        if (logging())
+            printf("GraphObject %p (imageID=%s, x=%d, y=%d, dir=%s) moving to (x=%d, y=%d)\n", this,
+                   describeIID(m_imageID), m_x, m_y, describeDirection(m_direction), x, y);
         assert(0 <= x);
         assert(0 <= y);
         assert(x < VIEW_WIDTH);
@@ -29,10 +38,16 @@ public:
         m_x = x;
         m_y = y;
     }
+    void setVisible(bool shouldIDisplay) {
+        if (logging())
+            printf("GraphObject %p (imageID=%s, x=%d, y=%d, dir=%s) %s\n", this, describeIID(m_imageID), m_x, m_y,
+                   describeDirection(m_direction), shouldIDisplay ? "shown" : "hidden");
+    }
     Direction getDirection() const { return m_direction; }
     void setDirection(Direction d) {
-        printf("GraphObject %p (imageID=%s, x=%d, y=%d, dir=%s) changing direction to %s\n", this,
-               describeIID(m_imageID), m_x, m_y, describeDirection(m_direction), describeDirection(d));
+        if (logging())
+            printf("GraphObject %p (imageID=%s, x=%d, y=%d, dir=%s) changing direction to %s\n", this,
+                   describeIID(m_imageID), m_x, m_y, describeDirection(m_direction), describeDirection(d));
         assert(d != none);
         m_direction = d;
     }
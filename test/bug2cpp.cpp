@@ -0,0 +1,87 @@
+#include "Compiler.h"
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+#include <string>
+using namespace std;
+
+// Translates an ant program into C++ defining the NativeProgram exported by a
+// shared object built from it; see NativeProgram.h. Every instruction becomes
+// a label, so jumps are plain gotos that the C++ compiler can lay out and
+// optimize like any other control flow.
+
+// Indexed by opcode.
+static char const* const opcodeNames[] = {"label", "goto", "if", "emitPheromone", "faceRandomDirection",
+                                          "rotateClockwise", "rotateCounterClockwise", "moveForward", "bite",
+                                          "pickupFood", "dropFood", "eatFood", "generateRandomNumber"};
+
+static string quoted(string const& s) {
+    string q = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') q += '\\';
+        q += c;
+    }
+    return q + '"';
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        cerr << "Usage: " << argv[0] << " program.bug > program.native.cpp\n";
+        return 2;
+    }
+    Compiler c;
+    string error;
+    if (!c.compile(argv[1], error)) {
+        cerr << argv[1] << ": " << error << '\n';
+        return 1;
+    }
+    auto const& program = c.getInstructions();
+    size_t const n = program.size();
+
+    printf("// Generated by bug2cpp from %s. Do not edit.\n", argv[1]);
+    printf("#include \"NativeProgram.h\"\n\n");
+    printf("namespace {\n");
+    if (n) {
+        printf("Compiler::Instruction const instructions[] = {\n");
+        for (Compiler::Instruction const& instr : program)
+            printf("    {%d, %d, %d, %d},\n", instr.opcode, instr.condition, instr.cost, instr.operand);
+        printf("};\n\n");
+    }
+    printf("int burst(void* ant, std::uint32_t* pc, JitProgram::Callbacks const& callbacks) {\n");
+    printf("    int executed = 0;\n");
+    printf("#define STEP(i) if (executed == 10) { *pc = i; return executed; } ++executed\n");
+    printf("    switch (*pc) {\n");
+    for (size_t i = 0; i < n; ++i) printf("    case %zu: goto pc%zu;\n", i, i);
+    printf("    default: goto pc%zu;\n", n);
+    printf("    }\n");
+    for (size_t i = 0; i < n; ++i) {
+        Compiler::Instruction const& instr = program[i];
+        printf("pc%zu: // %s\n", i, opcodeNames[instr.opcode]);
+        printf("    STEP(%zu);\n", i);
+        switch (static_cast<Compiler::Opcode>(instr.opcode)) {
+        case Compiler::Opcode::goto_command: printf("    goto pc%d;\n", instr.operand); break;
+        case Compiler::Opcode::if_command:
+            printf("    if (callbacks.condition(ant, %d)) goto pc%d;\n", instr.condition, instr.operand);
+            break;
+        case Compiler::Opcode::generateRandomNumber:
+            printf("    callbacks.generate(ant, %d);\n", instr.operand);
+            break;
+        default:
+            printf("    callbacks.action(ant, %d);\n", instr.opcode);
+            printf("    *pc = %zu;\n", i + 1);
+            printf("    return executed;\n");
+            break;
+        }
+    }
+    // The end of the program, where jumps past the last instruction land too.
+    printf("pc%zu:\n", n);
+    printf("    if (executed < 10) callbacks.fellOff(ant);\n");
+    printf("    *pc = %zu;\n", n);
+    printf("    return executed;\n");
+    printf("#undef STEP\n");
+    printf("}\n");
+    printf("} // namespace\n\n");
+    printf("extern \"C\" NativeProgram const bugsNativeProgram = {NativeProgram::abiVersion, %s, %s, %zu, burst};\n",
+           quoted(c.getColonyName()).c_str(), n ? "instructions" : "nullptr", n);
+    return 0;
+}
@@ -1,6 +1,24 @@
 #include "GameWorld.h"
+#include "GraphObject.h"
+#include "RandomStream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 using namespace std;
 
 const string assetDirectory = "Assets";
@@ -8,9 +26,263 @@ const string assetDirectory = "Assets";
 class GameWorld;
 
 GameWorld* createStudentWorld(string assetDir = "");
+void writeStudentWorldStatistics(GameWorld* gw, ostream& os);
+bool setStudentWorldAntDispatch(GameWorld* gw, string const& name);
+void setStudentWorldSeed(GameWorld* gw, unsigned seed);
+void getStudentWorldResults(GameWorld* gw, int& winningColony, vector<int>& antCounts);
+void setStudentWorldTickThreads(GameWorld* gw, unsigned threads);
+void setStudentWorldProgramCacheFiles(bool enabled);
+double benchmarkStudentWorldAntDispatch(GameWorld* gw, int rounds, uint64_t& instructions);
+
+static bool printStatistics = false;
+static bool benchmark = false;
+static string tournamentManifest;
+static unsigned tournamentThreads = 0;
+static string dispatchName;
+
+// Times drawing random numbers with the bounds actors draw them with: from the
+// global randInt, and from an actor's RandomStream as StudentWorld::randInt
+// does, both with a uniform_int_distribution and with boundedRandom.
+void benchRandom() {
+    static int const bounds[][2] = {{0, 1}, {0, 2}, {0, 3}, {0, 9}, {2, 10}, {0, 99}};
+    int const draws = 1 << 22;
+    auto time = [&](char const* name, auto draw) {
+        double best = numeric_limits<double>::infinity();
+        uint64_t sum = 0;
+        for (int i = 0; i < 5; ++i) {
+            auto start = chrono::steady_clock::now();
+            for (int j = 0; j < draws; ++j) sum += draw(bounds[j % 6][0], bounds[j % 6][1]);
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        cerr << name << ": " << draws / best / 1e6 << " million draws per second (checksum " << sum % 1000 << ")\n";
+    };
+    time("randInt", [](int min, int max) { return randInt(min, max); });
+    uint32_t n = 0;
+    PhiloxCounter block{};
+    time("RandomStream with uniform_int_distribution", [&](int min, int max) {
+        RandomStream stream(12345, 42, n >> 8, n, block);
+        uniform_int_distribution<> distro(min, max);
+        return distro(stream);
+    });
+    n = 0;
+    time("RandomStream with boundedRandom", [&](int min, int max) {
+        RandomStream stream(12345, 42, n >> 8, n, block);
+        return min + static_cast<int>(boundedRandom(stream, static_cast<uint32_t>(max - min) + 1));
+    });
+}
+
+// Plays half a game to populate the world, discarding the usual output, then
+// times the same bursts of all ants with each way of dispatching instructions.
+void bench(GameWorld* gw) {
+    fflush(stdout);
+    if (!freopen("/dev/null", "w", stdout)) return;
+    if (gw->init() == GWSTATUS_LEVEL_ERROR) {
+        cerr << "Error in data file! " << gw->getError() << '\n';
+        return;
+    }
+    for (int i = 0; i < 1000 && gw->move() == GWSTATUS_CONTINUE_GAME; ++i) {}
+    for (char const* dispatch : {"switch", "threaded", "table", "jit", "batch"}) {
+        if (!setStudentWorldAntDispatch(gw, dispatch)) continue;
+        double best = numeric_limits<double>::infinity();
+        uint64_t instructions = 0;
+        for (int i = 0; i < 5; ++i) best = min(best, benchmarkStudentWorldAntDispatch(gw, 200, instructions));
+        cerr << dispatch << " dispatch: " << instructions << " instructions in " << best * 1e3 << " ms, "
+             << best * 1e9 / max<uint64_t>(instructions, 1) << " ns per instruction\n";
+    }
+    gw->cleanUp();
+    benchRandom();
+}
+
+// A round robin: every choice of the given number of colonies among the
+// programs, in the order they are listed, plays once on every field with every
+// seed.
+struct Tournament {
+    vector<string> programs, fields;
+    vector<unsigned> seeds;
+    size_t colonies;
+};
+
+struct Match {
+    vector<size_t> programs;
+    size_t field;
+    unsigned seed;
+    int winner;
+    vector<int> antCounts;
+    string error;
+};
+
+// Reads a tournament manifest, made of lines "program FILE", "field FILE",
+// "seed N..." and "colonies N" in any order, where # starts a comment.
+// Without a colonies line, up to four programs play each match.
+bool readManifest(string const& fileName, Tournament& t, string& error) {
+    ifstream in(fileName);
+    if (!in) {
+        error = "Cannot open file";
+        return false;
+    }
+    t = {{}, {}, {}, 0};
+    string line;
+    for (int lineNumber = 1; getline(in, line); ++lineNumber) {
+        istringstream words(line.substr(0, line.find('#')));
+        string directive, word;
+        if (!(words >> directive)) continue;
+        bool ok = true;
+        if (directive == "program" || directive == "field") {
+            ok = static_cast<bool>(words >> word);
+            (directive == "program" ? t.programs : t.fields).emplace_back(word);
+        } else if (directive == "seed") {
+            for (unsigned long seed; ok && words >> word;) {
+                char* end;
+                seed = strtoul(word.c_str(), &end, 10);
+                ok = !*end && seed <= numeric_limits<unsigned>::max();
+                t.seeds.emplace_back(static_cast<unsigned>(seed));
+            }
+        } else if (directive == "colonies") {
+            ok = words >> t.colonies && t.colonies >= 1 && t.colonies <= 4;
+        } else {
+            ok = false;
+        }
+        if (!ok || words >> word) {
+            error = "Invalid line " + to_string(lineNumber) + ": " + line;
+            return false;
+        }
+    }
+    if (!t.colonies) t.colonies = min<size_t>(4, t.programs.size());
+    if (t.programs.size() < t.colonies || t.fields.empty() || t.seeds.empty()) {
+        error = "Needs at least one field and seed, and as many programs as colonies";
+        return false;
+    }
+    return true;
+}
+
+// Plays the match in a world of its own, so that matches share nothing but
+// the compiled programs in the ProgramCache.
+void playMatch(Tournament const& t, Match& m) {
+    unique_ptr<GameWorld> gw(createStudentWorld(assetDirectory));
+    gw->addParameter(t.fields[m.field]);
+    for (size_t p : m.programs) gw->addParameter(t.programs[p]);
+    setStudentWorldSeed(gw.get(), m.seed);
+    if (!dispatchName.empty()) setStudentWorldAntDispatch(gw.get(), dispatchName);
+    if (gw->init() == GWSTATUS_LEVEL_ERROR) {
+        m.error = gw->getError().empty() ? "Cannot load " + t.fields[m.field] : gw->getError();
+    } else {
+        while (gw->move() == GWSTATUS_CONTINUE_GAME) {}
+        getStudentWorldResults(gw.get(), m.winner, m.antCounts);
+    }
+    gw->cleanUp();
+}
+
+// Plays all matches of the tournament on a fixed number of threads, then
+// writes the result of every match and a table of wins, losses and ants
+// produced per program. The output does not depend on the number of threads.
+void playTournament() {
+    Tournament t;
+    string error;
+    if (!readManifest(tournamentManifest, t, error)) {
+        cerr << tournamentManifest << ": " << error << '\n';
+        return;
+    }
+    vector<Match> matches;
+    vector<size_t> chosen(t.colonies);
+    for (size_t i = 0; i < t.colonies; ++i) chosen[i] = i;
+    for (;;) {
+        for (size_t field = 0; field < t.fields.size(); ++field)
+            for (unsigned seed : t.seeds) matches.push_back({chosen, field, seed, -1, {}, {}});
+        // Advance to the next combination in lexicographic order.
+        size_t i = t.colonies;
+        while (i > 0 && chosen[i - 1] == t.programs.size() - t.colonies + i - 1) --i;
+        if (i == 0) break;
+        ++chosen[i - 1];
+        for (size_t j = i; j < t.colonies; ++j) chosen[j] = chosen[j - 1] + 1;
+    }
+
+    unsigned threads = tournamentThreads ? tournamentThreads : max(1u, thread::hardware_concurrency());
+    GraphObject::logging() = false;
+    auto start = chrono::steady_clock::now();
+    atomic<size_t> next{0};
+    vector<thread> pool;
+    for (unsigned i = 0; i < threads; ++i)
+        pool.emplace_back([&] {
+            for (size_t m; (m = next++) < matches.size();) playMatch(t, matches[m]);
+        });
+    for (thread& worker : pool) worker.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    struct Standing {
+        int matches, wins, losses, ants;
+    };
+    vector<Standing> standings(t.programs.size(), {0, 0, 0, 0});
+    for (Match const& m : matches) {
+        cout << t.fields[m.field] << " seed " << m.seed << ':';
+        if (!m.error.empty()) {
+            cout << " error: " << m.error << '\n';
+            continue;
+        }
+        for (size_t c = 0; c < m.programs.size(); ++c) {
+            Standing& s = standings[m.programs[c]];
+            ++s.matches;
+            s.ants += m.antCounts[c];
+            if (m.winner >= 0) ++((int) c == m.winner ? s.wins : s.losses);
+            cout << ' ' << t.programs[m.programs[c]] << ' ' << m.antCounts[c] << ((int) c == m.winner ? "*" : "");
+        }
+        cout << '\n';
+    }
+    size_t width = 7;
+    for (string const& program : t.programs) width = max(width, program.size());
+    cout << '\n' << left << setw(width) << "Program" << right << setw(9) << "Matches" << setw(6) << "Wins"
+         << setw(8) << "Losses" << setw(11) << "No winner" << setw(8) << "Ants" << '\n';
+    for (size_t p = 0; p < t.programs.size(); ++p) {
+        Standing const& s = standings[p];
+        cout << left << setw(width) << t.programs[p] << right << setw(9) << s.matches << setw(6) << s.wins
+             << setw(8) << s.losses << setw(11) << s.matches - s.wins - s.losses << setw(8) << s.ants << '\n';
+    }
+    cerr << "Played " << matches.size() << " matches on " << threads << " threads in " << elapsed << " s\n";
+}
 
 void run(int argc, char* argv[], GameWorld* gw, std::string windowTitle) {
-    for (int i = 1; i < argc; i++) gw->addParameter(argv[i]);
+    for (int i = 1; i < argc; i++)
+        if (!strcmp(argv[i], "--stats"))
+            printStatistics = true;
+        else if (!strcmp(argv[i], "--bench"))
+            benchmark = true;
+        else if (!strcmp(argv[i], "--cache-programs"))
+            setStudentWorldProgramCacheFiles(true);
+        else if (!strncmp(argv[i], "--tournament=", 13))
+            tournamentManifest = argv[i] + 13;
+        else if (!strncmp(argv[i], "--threads=", 10)) {
+            char* end;
+            unsigned long threads = strtoul(argv[i] + 10, &end, 10);
+            if (!argv[i][10] || *end || !threads || threads > 4096) {
+                fprintf(stderr, "Invalid number of threads: %s\n", argv[i] + 10);
+                return;
+            }
+            tournamentThreads = static_cast<unsigned>(threads);
+        } else if (!strncmp(argv[i], "--tick-threads=", 15)) {
+            char* end;
+            unsigned long threads = strtoul(argv[i] + 15, &end, 10);
+            if (!argv[i][15] || *end || !threads || threads > 4096) {
+                fprintf(stderr, "Invalid number of threads: %s\n", argv[i] + 15);
+                return;
+            }
+            setStudentWorldTickThreads(gw, static_cast<unsigned>(threads));
+        } else if (!strncmp(argv[i], "--seed=", 7)) {
+            char* end;
+            unsigned long seed = strtoul(argv[i] + 7, &end, 10);
+            if (!argv[i][7] || *end || seed > numeric_limits<unsigned>::max()) {
+                fprintf(stderr, "Invalid seed: %s\n", argv[i] + 7);
+                return;
+            }
+            setStudentWorldSeed(gw, static_cast<unsigned>(seed));
+        } else if (!strncmp(argv[i], "--dispatch=", 11)) {
+            if (!setStudentWorldAntDispatch(gw, argv[i] + 11)) {
+                fprintf(stderr, "Unsupported dispatch: %s\n", argv[i] + 11);
+                return;
+            }
+            dispatchName = argv[i] + 11;
+        } else
+            gw->addParameter(argv[i]);
+    if (benchmark) return bench(gw);
+    if (!tournamentManifest.empty()) return playTournament();
     {
         int status = gw->init();
         if (status == GWSTATUS_LEVEL_ERROR) {
@@ -31,6 +303,7 @@ void run(int argc, char* argv[], GameWorld* gw, std::string windowTitle) {
             break;
         }
     }
+    if (printStatistics) writeStudentWorldStatistics(gw, cerr);
     gw->cleanUp();
     return;
 }